@@ -5,9 +5,18 @@ classdef SherwoodSettings
 		% Maximum depth of each tree
 		MaxDecisionLevels = int32(5);
 
-		% Number of candidate feature response functions per split node
+		% Number of candidate feature response functions per split node.
+		% Axis-aligned candidates of a node use distinct features, so at
+		% most the number of features are evaluated.
 		NumberOfCandidateFeatures = int32(10);
 
+		% axis-aligned-hyperplane only. Number of features, drawn at
+		% random for each tree, that the split functions of the tree use;
+		% 0 (default) for all features. Bounds the work per tree on
+		% high-dimensional data. Random hyperplanes read all features and
+		% require 0.
+		FeaturesPerTree = int32(0);
+
 		% Optimal entropy split is determined by thresholding on 
 		% NumberOfCandidateThresholdsPerFeature equidistant points
 		NumberOfCandidateThresholdsPerFeature = int32(10);
@@ -33,9 +42,49 @@ classdef SherwoodSettings
 		% probability: calculate probability in each tree and then average over the trees.
 		TreeAggregator = 'histogram';
 
+		% axis-aligned-hyperplane only. Train on a feature-major copy of
+		% the features: faster, but the features are held twice in memory.
+		% Set to false when memory is short.
+		TransposeFeatures = true;
+
 		% Automatic scaling; it is faster to normalize the features prior
 		% to using sherwood and settings this setting to false.
 		FeatureScaling = true;
+
+		% Options {classification, regression}
+		% classification (default): integer labels, the trees store class histograms.
+		% regression: single precision targets, the trees store the mean and
+		% variance of the targets and splits minimize the variance.
+		Task = 'classification';
+
+		% Classification only. Evaluate trees in order for each example and
+		% stop once the most probable class can no longer change, or once its
+		% share exceeds EarlyExitConfidence after at least EarlyExitMinTrees
+		% trees. The default EarlyExitConfidence of 1 gives the same most
+		% probable class as evaluating all trees. The fifth output of
+		% sherwood_classify is the number of trees evaluated.
+		EarlyExit = false;
+		EarlyExitConfidence = 1.0;
+		EarlyExitMinTrees = int32(1);
+
+		% Train each tree on a bootstrap sample (drawn with replacement) of
+		% the training examples. sherwood_train then returns the out-of-bag
+		% error in stats.OutOfBagError: the misclassification rate (or mean
+		% squared error) of each example predicted by the trees not trained
+		% on it, and the confusion matrix stats.ConfusionMatrix(true, predicted).
+		Bootstrap = false;
+
+		% Function handle called as trees are trained, with the same struct
+		% as returned by sherwood_train (e.g. stats.TreesTrained and
+		% stats.SecondsRemaining). Empty (default) for none.
+		ProgressFcn = [];
+
+		% Seed of the random numbers of training; 0 (default) for a seed
+		% from the time. Each node of a tree has its own random numbers, so
+		% with the same Seed a forest trained with a smaller
+		% MaxDecisionLevels equals the top levels of a deeper one, as
+		% returned by sherwood_truncate.
+		Seed = int32(0);
 	end
 		
 	methods (Hidden)
@@ -43,13 +92,22 @@ classdef SherwoodSettings
 			settings.MaxDecisionLevels = self.MaxDecisionLevels;
 			settings.NumberOfCandidateFeatures = self.NumberOfCandidateFeatures;
 			settings.NumberOfCandidateThresholdsPerFeature = self.NumberOfCandidateThresholdsPerFeature;
+			settings.FeaturesPerTree = self.FeaturesPerTree;
 			settings.NumberOfTrees = self.NumberOfTrees;
 			settings.MaxThreads = self.MaxThreads;
 			settings.ForestName = self.ForestName;
 			settings.WeakLearner = self.WeakLearner;
 			settings.Verbose = self.Verbose;
 			settings.FeatureScaling = self.FeatureScaling;
+			settings.TransposeFeatures = self.TransposeFeatures;
 			settings.TreeAggregator = self.TreeAggregator;
+			settings.Task = self.Task;
+			settings.EarlyExit = self.EarlyExit;
+			settings.EarlyExitConfidence = self.EarlyExitConfidence;
+			settings.EarlyExitMinTrees = self.EarlyExitMinTrees;
+			settings.Bootstrap = self.Bootstrap;
+			settings.ProgressFcn = self.ProgressFcn;
+			settings.Seed = self.Seed;
 		end
 	end
 
@@ -78,6 +136,11 @@ classdef SherwoodSettings
                return
             end
   
+            if (self.FeaturesPerTree ~= other.FeaturesPerTree)
+                equvialent = false;
+                return
+            end
+
             if (self.NumberOfTrees ~= other.NumberOfTrees)
                 equvialent = false;
                 return
@@ -92,6 +155,11 @@ classdef SherwoodSettings
                 equvialent = false;
                 return
 			end
+
+            if (~strcmp(self.Task, other.Task))
+                equvialent = false;
+                return
+			end
         end
         
 		% Set functions
@@ -117,6 +185,17 @@ classdef SherwoodSettings
 			end
 		end
 
+		function self = set.Task(self, Task)
+			switch(Task)
+				case 'classification'
+					self.Task = 'classification';
+				case 'regression'
+					self.Task = 'regression';
+				otherwise	
+					error('Task available: classification, regression');
+			end
+		end
+
 		function self = set.MaxDecisionLevels(self, MaxDecisionLevels)
 			MaxDecisionLevels = int32(MaxDecisionLevels);
 
@@ -147,6 +226,16 @@ classdef SherwoodSettings
 			self.NumberOfCandidateThresholdsPerFeature = NumberOfCandidateThresholdsPerFeature;
 		end		
 
+		function self = set.FeaturesPerTree(self, FeaturesPerTree)
+			FeaturesPerTree = int32(FeaturesPerTree);
+
+			if (FeaturesPerTree < 0)
+				error('FeaturesPerTree must be >= 0')
+			end
+
+			self.FeaturesPerTree = FeaturesPerTree;
+		end
+
 		function self = set.NumberOfTrees(self, NumberOfTrees)
 			NumberOfTrees = int32(NumberOfTrees);
 
@@ -175,5 +264,55 @@ classdef SherwoodSettings
 		function self = set.FeatureScaling(self, FeatureScaling)
 			self.FeatureScaling = logical(FeatureScaling);
 		end
+
+		function self = set.TransposeFeatures(self, TransposeFeatures)
+			self.TransposeFeatures = logical(TransposeFeatures);
+		end
+
+		function self = set.EarlyExit(self, EarlyExit)
+			self.EarlyExit = logical(EarlyExit);
+		end
+
+		function self = set.EarlyExitConfidence(self, EarlyExitConfidence)
+			EarlyExitConfidence = double(EarlyExitConfidence);
+
+			if (EarlyExitConfidence <= 0 || EarlyExitConfidence > 1)
+				error('EarlyExitConfidence must be in (0, 1]')
+			end
+
+			self.EarlyExitConfidence = EarlyExitConfidence;
+		end
+
+		function self = set.EarlyExitMinTrees(self, EarlyExitMinTrees)
+			EarlyExitMinTrees = int32(EarlyExitMinTrees);
+
+			if (EarlyExitMinTrees < 1)
+				error('EarlyExitMinTrees must be >= 1')
+			end
+
+			self.EarlyExitMinTrees = EarlyExitMinTrees;
+		end
+
+		function self = set.Bootstrap(self, Bootstrap)
+			self.Bootstrap = logical(Bootstrap);
+		end
+
+		function self = set.ProgressFcn(self, ProgressFcn)
+			if ~(isempty(ProgressFcn) || isa(ProgressFcn, 'function_handle'))
+				error('ProgressFcn must be a function handle or empty')
+			end
+
+			self.ProgressFcn = ProgressFcn;
+		end
+
+		function self = set.Seed(self, Seed)
+			Seed = int32(Seed);
+
+			if (Seed < 0)
+				error('Seed must be >= 0')
+			end
+
+			self.Seed = Seed;
+		end
 	end
 end
@@ -0,0 +1,106 @@
+// Replacement of the global allocation functions, counting the heap
+// allocations of sherwood-benchmark. It is a translation unit of its own so
+// that the compiler never sees malloc and free paired with new expressions
+// (-Wmismatched-new-delete).
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+
+static size_t allocation_count = 0;
+
+size_t AllocationCount()
+{
+  return allocation_count;
+}
+
+namespace {
+
+void* allocate(size_t size) noexcept
+{
+  allocation_count++;
+  return malloc(size == 0 ? 1 : size);
+}
+
+void* allocate_or_throw(size_t size)
+{
+  void* p = allocate(size);
+  if (!p) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+}
+
+void* operator new(size_t size) { return allocate_or_throw(size); }
+void* operator new[](size_t size) { return allocate_or_throw(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return allocate(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return allocate(size); }
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { free(p); }
+
+#if defined(__cpp_sized_deallocation)
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+#endif
+
+#if defined(__cpp_aligned_new)
+
+namespace {
+
+void* allocate_aligned(size_t size, std::align_val_t alignment) noexcept
+{
+  allocation_count++;
+  size = size == 0 ? 1 : size;
+
+#if defined(_WIN32)
+  return _aligned_malloc(size, (size_t)alignment);
+#else
+  void* p = 0;
+  if (posix_memalign(&p, std::max((size_t)alignment, sizeof(void*)), size) != 0) {
+    return 0;
+  }
+  return p;
+#endif
+}
+
+void* allocate_aligned_or_throw(size_t size, std::align_val_t alignment)
+{
+  void* p = allocate_aligned(size, alignment);
+  if (!p) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void free_aligned(void* p) noexcept
+{
+#if defined(_WIN32)
+  _aligned_free(p);
+#else
+  free(p);
+#endif
+}
+
+}
+
+void* operator new(size_t size, std::align_val_t alignment) { return allocate_aligned_or_throw(size, alignment); }
+void* operator new[](size_t size, std::align_val_t alignment) { return allocate_aligned_or_throw(size, alignment); }
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return allocate_aligned(size, alignment); }
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return allocate_aligned(size, alignment); }
+
+void operator delete(void* p, std::align_val_t) noexcept { free_aligned(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { free_aligned(p); }
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept { free_aligned(p); }
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept { free_aligned(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { free_aligned(p); }
+void operator delete[](void* p, size_t, std::align_val_t) noexcept { free_aligned(p); }
+
+#endif
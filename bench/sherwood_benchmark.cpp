@@ -0,0 +1,325 @@
+// Benchmarks of the training and classification hot paths on synthetic
+// data, runnable without MATLAB.
+//
+// Build with -DSHERWOOD_BUILD_BENCHMARKS=ON and run
+//   ./sherwood-benchmark --benchmark_filter=Classify
+//
+// Items per second is examples (or examples times trees) per second and
+// allocs the number of heap allocations per iteration.
+#include "sherwood_core.h"
+#include "train_forest.h"
+#include "classify_forest.h"
+
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <random>
+#include <sstream>
+
+using namespace MicrosoftResearch::Cambridge::Sherwood;
+
+// Number of heap allocations so far, counted by the allocation functions
+// replaced in allocation_counter.cpp.
+size_t AllocationCount();
+
+// Reports the allocations made while in scope per benchmark iteration.
+class AllocationCounter
+{
+public:
+  AllocationCounter(benchmark::State& state)
+  : state(state), start(AllocationCount())
+  {}
+
+  ~AllocationCounter()
+  {
+    state.counters["allocs"] = benchmark::Counter((double)(AllocationCount() - start), benchmark::Counter::kAvgIterations);
+  }
+
+private:
+  benchmark::State& state;
+  size_t start;
+};
+
+// Gaussian clusters, one per class, with features along rows.
+struct SyntheticData
+{
+  std::vector<float> features;
+  std::vector<unsigned int> labels;
+  unsigned int dimensions;
+  unsigned int count;
+
+  SyntheticData(unsigned int count, unsigned int dimensions, unsigned int classes, unsigned int seed = 1)
+  : features((size_t)count * dimensions), labels(count), dimensions(dimensions), count(count)
+  {
+    Random random(seed);
+
+    std::vector<float> centers((size_t)classes * dimensions);
+    for (size_t i = 0; i < centers.size(); i++) {
+      centers[i] = 4 * (float)random.NextDouble();
+    }
+
+    for (unsigned int i = 0; i < count; i++) {
+      labels[i] = random.Next(0, classes);
+
+      for (unsigned int d = 0; d < dimensions; d++) {
+        features[(size_t)i*dimensions + d] = centers[labels[i]*dimensions + d] + randn(random);
+      }
+    }
+  }
+
+  DataPointCollection Collection() const
+  {
+    return DataPointCollection(&features[0], dimensions, count, &labels[0], DataPointCollection::UInt32Labels);
+  }
+};
+
+TrainingParameters Parameters(int depth)
+{
+  TrainingParameters parameters;
+  parameters.MaxDecisionLevels = depth;
+  parameters.NumberOfCandidateFeatures = 10;
+  parameters.NumberOfCandidateThresholdsPerFeature = 10;
+  parameters.NumberOfTrees = 1;
+  parameters.Verbose = false;
+  return parameters;
+}
+
+std::vector<Stats> FeatureStats(const DataPointCollection& data)
+{
+  std::vector<Stats> featureStats;
+  for (unsigned int d = 0; d < data.Dimensions(); d++) {
+    featureStats.push_back(data.GetStats(d));
+  }
+  return featureStats;
+}
+
+template<typename F>
+std::auto_ptr<Forest<F, HistogramAggregator> > SyntheticForest(const SyntheticData& synthetic, int trees, int depth)
+{
+  DataPointCollection data = synthetic.Collection();
+  FeatureFactory<F> featureFactory(data.Dimensions(), FeatureStats(data));
+  ClassificationTrainingContext<F> context(data.CountClasses(), &featureFactory);
+
+  Random random(1);
+  std::auto_ptr<Forest<F, HistogramAggregator> > forest(new Forest<F, HistogramAggregator>());
+  for (int t = 0; t < trees; t++) {
+    TrainingStatistics statistics;
+    forest->AddTree(TrainTree(random, context, Parameters(depth), data, statistics));
+  }
+
+  return forest;
+}
+
+// Args: examples, dimensions
+void BM_GetStats(benchmark::State& state)
+{
+  SyntheticData synthetic(state.range(0), state.range(1), 2);
+  DataPointCollection data = synthetic.Collection();
+
+  AllocationCounter allocations(state);
+  for (auto _ : state) {
+    for (unsigned int d = 0; d < data.Dimensions(); d++) {
+      benchmark::DoNotOptimize(data.GetStats(d));
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * data.Count());
+}
+BENCHMARK(BM_GetStats)->Args({10000, 2})->Args({10000, 32})->Args({100000, 32});
+
+// Args: dimensions
+template<typename F>
+void BM_GetResponse(benchmark::State& state)
+{
+  SyntheticData synthetic(10000, state.range(0), 2);
+  DataPointCollection data = synthetic.Collection();
+  std::vector<Stats> featureStats = FeatureStats(data);
+
+  Random random(1);
+  F feature = F::CreateRandom(random, data.Dimensions(), featureStats);
+
+  AllocationCounter allocations(state);
+  for (auto _ : state) {
+    float sum = 0;
+    for (unsigned int i = 0; i < data.Count(); i++) {
+      sum += feature.GetResponse(data, i);
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+
+  state.SetItemsProcessed(state.iterations() * data.Count());
+}
+BENCHMARK_TEMPLATE(BM_GetResponse, AxisAlignedFeatureResponse)->Arg(2)->Arg(32)->Arg(256);
+BENCHMARK_TEMPLATE(BM_GetResponse, RandomHyperplaneFeatureResponse)->Arg(2)->Arg(32)->Arg(256);
+BENCHMARK_TEMPLATE(BM_GetResponse, RandomHyperplaneFeatureResponseNormalized)->Arg(2)->Arg(32)->Arg(256);
+
+// Args: dimensions, transposed
+template<typename F>
+void BM_GetResponses(benchmark::State& state)
+{
+  SyntheticData synthetic(10000, state.range(0), 2);
+  DataPointCollection data = synthetic.Collection();
+  std::vector<Stats> featureStats = FeatureStats(data);
+
+  if (state.range(1)) {
+    data.TransposeFeatures();
+  }
+
+  Random random(1);
+  F feature = F::CreateRandom(random, data.Dimensions(), featureStats);
+
+  // A node sees its data points in the order left by partitioning.
+  std::vector<unsigned int> indices(data.Count());
+  for (unsigned int i = 0; i < data.Count(); i++) {
+    indices[i] = i;
+  }
+  std::mt19937 engine(1);
+  std::shuffle(indices.begin(), indices.end(), engine);
+
+  std::vector<float> responses(data.Count());
+
+  AllocationCounter allocations(state);
+  for (auto _ : state) {
+    feature.GetResponses(data, &indices[0], data.Count(), &responses[0]);
+    benchmark::DoNotOptimize(&responses[0]);
+  }
+
+  state.SetItemsProcessed(state.iterations() * data.Count());
+}
+BENCHMARK_TEMPLATE(BM_GetResponses, AxisAlignedFeatureResponse)
+  ->Args({2, 0})->Args({32, 0})->Args({256, 0})->Args({32, 1})->Args({256, 1});
+BENCHMARK_TEMPLATE(BM_GetResponses, RandomHyperplaneFeatureResponse)->Args({2, 0})->Args({32, 0})->Args({256, 0});
+BENCHMARK_TEMPLATE(BM_GetResponses, RandomHyperplaneFeatureResponseNormalized)->Args({2, 0})->Args({32, 0})->Args({256, 0});
+
+// Args: examples, classes
+void BM_HistogramAggregate(benchmark::State& state)
+{
+  SyntheticData synthetic(state.range(0), 2, state.range(1));
+  DataPointCollection data = synthetic.Collection();
+  HistogramAggregator histogram(data.CountClasses());
+
+  AllocationCounter allocations(state);
+  for (auto _ : state) {
+    histogram.Clear();
+    for (unsigned int i = 0; i < data.Count(); i++) {
+      histogram.Aggregate(data, i);
+    }
+    benchmark::DoNotOptimize(histogram.SampleCount());
+  }
+
+  state.SetItemsProcessed(state.iterations() * data.Count());
+}
+BENCHMARK(BM_HistogramAggregate)->Args({10000, 2})->Args({10000, 100})->Args({10000, 1000});
+
+// Args: classes
+void BM_HistogramEntropy(benchmark::State& state)
+{
+  SyntheticData synthetic(10000, 2, state.range(0));
+  DataPointCollection data = synthetic.Collection();
+  HistogramAggregator histogram(data.CountClasses());
+  for (unsigned int i = 0; i < data.Count(); i++) {
+    histogram.Aggregate(data, i);
+  }
+
+  AllocationCounter allocations(state);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(histogram.Entropy());
+  }
+
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_HistogramEntropy)->Arg(2)->Arg(10)->Arg(100)->Arg(1000);
+
+// Args: examples, dimensions, classes, depth
+template<typename F>
+void BM_TrainTree(benchmark::State& state)
+{
+  SyntheticData synthetic(state.range(0), state.range(1), state.range(2));
+  DataPointCollection data = synthetic.Collection();
+  FeatureFactory<F> featureFactory(data.Dimensions(), FeatureStats(data));
+  ClassificationTrainingContext<F> context(data.CountClasses(), &featureFactory);
+  TrainingParameters parameters = Parameters(state.range(3));
+
+  // The layout TrainForest uses.
+  if (F::FeatureMajor()) {
+    data.TransposeFeatures();
+  }
+
+  Random random(1);
+
+  AllocationCounter allocations(state);
+  for (auto _ : state) {
+    TrainingStatistics statistics;
+    std::auto_ptr<Tree<F, HistogramAggregator> > tree = TrainTree(random, context, parameters, data, statistics);
+    benchmark::DoNotOptimize(tree.get());
+  }
+
+  state.SetItemsProcessed(state.iterations() * data.Count());
+}
+BENCHMARK_TEMPLATE(BM_TrainTree, AxisAlignedFeatureResponse)
+  ->Args({10000, 2, 3, 10})->Args({10000, 32, 10, 10})->Args({100000, 32, 10, 15})->Args({10000, 32, 1000, 10})
+  ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_TrainTree, RandomHyperplaneFeatureResponse)
+  ->Args({10000, 2, 3, 10})->Args({10000, 32, 10, 10})->Args({100000, 32, 10, 15})
+  ->Unit(benchmark::kMillisecond);
+
+// Args: trees, depth, classes
+void BM_Deserialize(benchmark::State& state)
+{
+  SyntheticData synthetic(10000, 8, state.range(2));
+  std::auto_ptr<Forest<RandomHyperplaneFeatureResponse, HistogramAggregator> > forest =
+    SyntheticForest<RandomHyperplaneFeatureResponse>(synthetic, state.range(0), state.range(1));
+
+  std::stringstream serialized;
+  forest->Serialize(serialized);
+  std::string bytes = serialized.str();
+
+  AllocationCounter allocations(state);
+  for (auto _ : state) {
+    std::istringstream in(bytes);
+    std::auto_ptr<Forest<RandomHyperplaneFeatureResponse, HistogramAggregator> > loaded =
+      Forest<RandomHyperplaneFeatureResponse, HistogramAggregator>::Deserialize(in);
+    benchmark::DoNotOptimize(loaded.get());
+  }
+
+  state.SetBytesProcessed(state.iterations() * bytes.size());
+}
+BENCHMARK(BM_Deserialize)->Args({10, 10, 10})->Args({100, 10, 10})->Args({10, 15, 1000})
+  ->Unit(benchmark::kMillisecond);
+
+// Args: examples, trees, depth, early exit
+template<typename F>
+void BM_Classify(benchmark::State& state)
+{
+  SyntheticData training(10000, 8, 10);
+  std::auto_ptr<Forest<F, HistogramAggregator> > forest = SyntheticForest<F>(training, state.range(1), state.range(2));
+
+  SyntheticData test(state.range(0), 8, 10, 2);
+  DataPointCollection data(&test.features[0], test.dimensions, test.count);
+
+  Options options;
+  options.EarlyExit = state.range(3) != 0;
+
+  unsigned int num_classes = CountClasses(*forest);
+  std::vector<float> probabilities((size_t)num_classes * data.Count());
+
+  AllocationCounter allocations(state);
+  for (auto _ : state) {
+    std::fill(probabilities.begin(), probabilities.end(), 0.0f);
+
+    ClassificationOutputs out;
+    out.probabilities = &probabilities[0];
+    ClassifyForest(*forest, data, options, out);
+
+    benchmark::DoNotOptimize(probabilities[0]);
+  }
+
+  state.SetItemsProcessed(state.iterations() * data.Count() * forest->TreeCount());
+}
+BENCHMARK_TEMPLATE(BM_Classify, AxisAlignedFeatureResponse)
+  ->Args({100000, 30, 10, 0})->Args({100000, 30, 10, 1})->Args({100000, 100, 15, 0})
+  ->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Classify, RandomHyperplaneFeatureResponse)
+  ->Args({100000, 30, 10, 0})->Args({100000, 30, 10, 1})
+  ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -1,53 +1,115 @@
-template<class F>
-class IFeatureResponseFactory
-{
-public:
-  virtual F CreateRandom(Random& random)=0;
-};
-
-template<class F>
-class ClassificationTrainingContext : public ITrainingContext<F,HistogramAggregator> // where F:IFeatureResponse
-{
-private:
-  unsigned int nClasses_;
-
-  IFeatureResponseFactory<F>* featureFactory_;
-
-public:
-  ClassificationTrainingContext(unsigned int nClasses, IFeatureResponseFactory<F>* featureFactory)
-  {
-    nClasses_ = nClasses;
-    featureFactory_ = featureFactory;
-  }
-
-private:
-  // Implementation of ITrainingContext
-  F GetRandomFeature(Random& random)
-  {
-    return featureFactory_->CreateRandom(random);
-  }
-
-  HistogramAggregator GetStatisticsAggregator()
-  {
-    return HistogramAggregator(nClasses_);
-  }
-
-  double ComputeInformationGain(const HistogramAggregator& allStatistics, const HistogramAggregator& leftStatistics, const HistogramAggregator& rightStatistics)
-  {
-    double entropyBefore = allStatistics.Entropy();
-
-    unsigned int nTotalSamples = leftStatistics.SampleCount() + rightStatistics.SampleCount();
-
-    if (nTotalSamples <= 1)
-      return 0.0;
-
-    double entropyAfter = (leftStatistics.SampleCount() * leftStatistics.Entropy() + rightStatistics.SampleCount() * rightStatistics.Entropy()) / nTotalSamples;
-
-    return entropyBefore - entropyAfter;
-  }
-
-  bool ShouldTerminate(const HistogramAggregator& parent, const HistogramAggregator& leftChild, const HistogramAggregator& rightChild, double gain)
-  {
-    return gain < 0.01;
-  }
+template<class F>
+class IFeatureResponseFactory
+{
+public:
+  virtual F CreateRandom(Random& random)=0;
+
+  // As CreateRandom, reusing the storage of feature.
+  virtual void CreateRandom(Random& random, F& feature)
+  {
+    feature = CreateRandom(random);
+  }
+};
+
+// Training context drawing features from a factory. Training draws the
+// candidate features into the same objects over and over, so that their
+// coefficients are allocated once per tree and not once per candidate.
+template<class F, class S>
+class FeatureTrainingContext : public ITrainingContext<F,S>
+{
+protected:
+  IFeatureResponseFactory<F>* featureFactory_;
+
+  FeatureTrainingContext(IFeatureResponseFactory<F>* featureFactory)
+  : featureFactory_(featureFactory)
+  {}
+
+public:
+  F GetRandomFeature(Random& random)
+  {
+    return featureFactory_->CreateRandom(random);
+  }
+
+  void GetRandomFeature(Random& random, F& feature)
+  {
+    featureFactory_->CreateRandom(random, feature);
+  }
+};
+
+template<class F>
+class ClassificationTrainingContext : public FeatureTrainingContext<F,HistogramAggregator> // where F:IFeatureResponse
+{
+private:
+  unsigned int nClasses_;
+
+public:
+  ClassificationTrainingContext(unsigned int nClasses, IFeatureResponseFactory<F>* featureFactory)
+  : FeatureTrainingContext<F,HistogramAggregator>(featureFactory)
+  {
+    nClasses_ = nClasses;
+  }
+
+private:
+  // Implementation of ITrainingContext
+  HistogramAggregator GetStatisticsAggregator()
+  {
+    return HistogramAggregator(nClasses_);
+  }
+
+  double ComputeInformationGain(const HistogramAggregator& allStatistics, const HistogramAggregator& leftStatistics, const HistogramAggregator& rightStatistics)
+  {
+    double entropyBefore = allStatistics.Entropy();
+
+    unsigned int nTotalSamples = leftStatistics.SampleCount() + rightStatistics.SampleCount();
+
+    if (nTotalSamples <= 1)
+      return 0.0;
+
+    double entropyAfter = (leftStatistics.SampleCount() * leftStatistics.Entropy() + rightStatistics.SampleCount() * rightStatistics.Entropy()) / nTotalSamples;
+
+    return entropyBefore - entropyAfter;
+  }
+
+  bool ShouldTerminate(const HistogramAggregator& parent, const HistogramAggregator& leftChild, const HistogramAggregator& rightChild, double gain)
+  {
+    return gain < 0.01;
+  }
+};
+
+template<class F>
+class RegressionTrainingContext : public FeatureTrainingContext<F,GaussianAggregator1d> // where F:IFeatureResponse
+{
+public:
+  RegressionTrainingContext(IFeatureResponseFactory<F>* featureFactory)
+  : FeatureTrainingContext<F,GaussianAggregator1d>(featureFactory)
+  {}
+
+private:
+  // Implementation of ITrainingContext
+  GaussianAggregator1d GetStatisticsAggregator()
+  {
+    return GaussianAggregator1d();
+  }
+
+  // Reduction in variance (sum of squared errors per sample).
+  double ComputeInformationGain(const GaussianAggregator1d& allStatistics, const GaussianAggregator1d& leftStatistics, const GaussianAggregator1d& rightStatistics)
+  {
+    double varianceBefore = allStatistics.Variance();
+
+    unsigned int nTotalSamples = leftStatistics.SampleCount() + rightStatistics.SampleCount();
+
+    if (nTotalSamples <= 1)
+      return 0.0;
+
+    double varianceAfter = (leftStatistics.SampleCount() * leftStatistics.Variance() + rightStatistics.SampleCount() * rightStatistics.Variance()) / nTotalSamples;
+
+    return varianceBefore - varianceAfter;
+  }
+
+  // The variance depends on the scale of the targets, so the threshold is
+  // relative to the variance of the parent.
+  bool ShouldTerminate(const GaussianAggregator1d& parent, const GaussianAggregator1d& leftChild, const GaussianAggregator1d& rightChild, double gain)
+  {
+    return gain < 0.01 * parent.Variance();
+  }
 };
\ No newline at end of file
@@ -1,145 +1,314 @@
-// Implementation of DataPoint for Sherwood
-// for MATLAB matrices. No data is copied.
-#pragma once
-
-#include "sherwood_mex.h"
-#include <set>
-#include <math.h>
-
-using namespace MicrosoftResearch::Cambridge::Sherwood;
-
-/// <summary>
-/// A collection of data points, each represented by a float[] and (optionally)
-/// associated with a string class label and/or a float target value.
-/// </summary>
-class DataPointCollection: public IDataPointCollection
-{
-public:
-
-  DataPointCollection(const matrix<float>& features) : features(features)
-  {
-    // features(feature_id, example_id)
-    numFeatures = features.M;
-    numPoints   = features.N;
-
-    numLabels = 0;
-  }; 
-
-  DataPointCollection(const matrix<float>& features, const matrix<unsigned char>& labels) 
-  : features(features), labels(labels)
-  {
-    // features(feature_id, example_id)
-    numFeatures = features.M;
-    numPoints   = features.N;
-
-    std::set<unsigned int> la(&labels.data[0], &labels.data[numPoints]);
-    numLabels = la.size();
-  }; 
-
-  bool HasLabels() const
-  {
-    return (numLabels != 0);
-  }
-
-  unsigned int CountClasses() const
-  {
-    if (!HasLabels())
-      throw std::runtime_error("Unlabelled data.");
-    return numLabels;
-  }
-
-  bool HasTargetValues() const
-  {
-    return false;
-  }
-
-  unsigned int Count() const
-  {
-    return numPoints;
-  }
-
-  /// <returns>A tuple containing min and max over the specified dimension of the data</returns>
-  std::pair<float, float> GetRange(int dimension) const
-  {
-    if (Count() < 0)
-      throw std::runtime_error("Insufficient features to compute range.");
-
-    if (dimension < 0 || dimension> numFeatures)
-      throw std::runtime_error("Insufficient features to compute range.");
-
-    float min = features(dimension,0);
-    float max = features(dimension,0);
-
-    for (unsigned int i =1; i < numPoints; i++)
-    {
-      if (features(dimension,i)  < min)
-        min = features(dimension,i);
-      else if (features(dimension,i) > max)
-        max = features(dimension,i);
-    }
-
-    return std::pair<float, float>(min, max);
-  }
-
-  /// <summary>
-  /// Get the range of target values (or raise an exception if these data
-  /// do not have associated target values).
-  /// </summary>
-  /// <returns>A tuple containing the min and max target value for the data</returns>
-  std::pair<float, float> GetTargetRange() const
-  {
-    throw std::runtime_error("Target not implemented.");
-  }
-
-  unsigned int Dimensions() const
-  {
-    return numFeatures;
-  }
-
-  /// Returns Pointer to the first element of the data point.
-  const float* GetDataPoint(unsigned int i) const
-  {   
-    return &features.data[i*numFeatures];
-    //return &data_[i*dimension_];
-  }
-
-  unsigned int GetIntegerLabel(unsigned int i) const
-  {
-    return labels(i);
-  }
-
-  float GetTarget(int i) const
-  {
-    throw std::runtime_error("Data have no associated target values.");
-  }
-
-  Stats GetStats(int d) {
-
-    float mean = features(d,0);
-    for (unsigned int i = 1; i < numPoints; i++)
-    {
-      mean += features(d,i);
-    } 
-
-    mean /= numPoints;
-
-    float stddev = (features(d,0) - mean)*(features(d,0) - mean);
-    for (unsigned int i = 1; i < numPoints; i++)
-    {
-      stddev += (features(d,i) - mean)*(features(d,i) - mean);
-    } 
-
-    stddev /= numPoints;
-    stddev = sqrt(stddev);
-
-    return Stats(mean,stddev);
-  }
-
-  // features(feature_id, example_id)
-  const matrix<float> features;
-  const matrix<unsigned char> labels;
-  unsigned int numPoints;
-  unsigned int numLabels;
-  unsigned int numFeatures;
-  static const int UnknownClassLabel = -1;
+// Implementation of DataPoint for Sherwood
+// for column major float arrays, e.g. MATLAB matrices. No data is copied.
+#pragma once
+
+#include "sherwood_core.h"
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+using namespace MicrosoftResearch::Cambridge::Sherwood;
+
+/// <summary>
+/// A collection of data points, each represented by a float[] and (optionally)
+/// associated with an integer class label and/or a float target value.
+/// </summary>
+class DataPointCollection: public IDataPointCollection
+{
+public:
+
+  // Integer types accepted for the class labels (uint8, uint16, uint32).
+  enum LabelType {NoLabels, UInt8Labels, UInt16Labels, UInt32Labels};
+
+  // Element types accepted for the features of data to classify.
+  enum FeatureType {SingleFeatures, DoubleFeatures, UInt8Features, UInt16Features};
+
+  // features[i*numFeatures + d] is feature d of example i.
+  DataPointCollection(const float* features, unsigned int numFeatures, unsigned int numPoints)
+  : features(features), numPoints(numPoints), numFeatures(numFeatures)
+  {
+    labels = 0;
+    labelType = NoLabels;
+    numLabels = 0;
+    targets = 0;
+    rawFeatures = features;
+    featureType = SingleFeatures;
+  }; 
+
+  // Features of any FeatureType, without labels. Unless the type is
+  // SingleFeatures the data points can only be read through blocks (see
+  // the block constructor with a buffer), which convert them to float a
+  // block at a time instead of copying the whole matrix.
+  DataPointCollection(const void* features, FeatureType featureType, unsigned int numFeatures, unsigned int numPoints)
+  : features(featureType == SingleFeatures ? (const float*)features : 0), numPoints(numPoints), numFeatures(numFeatures)
+  {
+    labels = 0;
+    labelType = NoLabels;
+    numLabels = 0;
+    targets = 0;
+    rawFeatures = features;
+    this->featureType = featureType;
+  }; 
+
+  // Integer labels 0, ..., n-1 give a classification problem.
+  DataPointCollection(const float* features, unsigned int numFeatures, unsigned int numPoints,
+                      const void* labels, LabelType labelType)
+  : features(features), labels(labels), labelType(labelType), numPoints(numPoints), numFeatures(numFeatures)
+  {
+    numLabels = 0;
+    targets = 0;
+    rawFeatures = features;
+    featureType = SingleFeatures;
+
+    if (labelType == NoLabels)
+      return;
+
+    // Labels are 0, 1, ..., n-1 so the number of classes is the largest label + 1.
+    for (unsigned int i = 0; i < numPoints; i++)
+    {
+      if (GetIntegerLabel(i) >= numLabels)
+        numLabels = GetIntegerLabel(i) + 1;
+    }
+  }; 
+
+  // Target values give a regression problem.
+  DataPointCollection(const float* features, unsigned int numFeatures, unsigned int numPoints,
+                      const float* targets)
+  : features(features), targets(targets), numPoints(numPoints), numFeatures(numFeatures)
+  {
+    labels = 0;
+    labelType = NoLabels;
+    numLabels = 0;
+    rawFeatures = features;
+    featureType = SingleFeatures;
+  }; 
+
+  // View of the examples first, ..., first+count-1 of data (single
+  // features), without labels.
+  DataPointCollection(const DataPointCollection& data, unsigned int first, unsigned int count)
+  : features(data.features + (size_t)first*data.numFeatures), numPoints(count), numFeatures(data.numFeatures)
+  {
+    labels = 0;
+    labelType = NoLabels;
+    numLabels = 0;
+    targets = 0;
+    rawFeatures = features;
+    featureType = SingleFeatures;
+  }; 
+
+  // As the view above for data of any FeatureType: features other than
+  // single are converted into buffer, which the view then refers to.
+  DataPointCollection(const DataPointCollection& data, unsigned int first, unsigned int count,
+                      std::vector<float>& buffer)
+  : features(0), numPoints(count), numFeatures(data.numFeatures)
+  {
+    labels = 0;
+    labelType = NoLabels;
+    numLabels = 0;
+    targets = 0;
+    featureType = SingleFeatures;
+
+    size_t offset = (size_t)first*numFeatures;
+    size_t size = (size_t)count*numFeatures;
+
+    if (data.featureType != SingleFeatures)
+      buffer.resize(size);
+
+    switch (data.featureType) {
+      case SingleFeatures: features = (const float*)data.rawFeatures + offset; break;
+      case DoubleFeatures: Convert((const double*)data.rawFeatures + offset, size, buffer); break;
+      case UInt8Features:  Convert((const unsigned char*)data.rawFeatures + offset, size, buffer); break;
+      case UInt16Features: Convert((const unsigned short*)data.rawFeatures + offset, size, buffer); break;
+      default: throw std::runtime_error("Unknown feature type.");
+    }
+
+    rawFeatures = features;
+  }; 
+
+  bool HasLabels() const
+  {
+    return (numLabels != 0);
+  }
+
+  unsigned int CountClasses() const
+  {
+    if (!HasLabels())
+      throw std::runtime_error("Unlabelled data.");
+    return numLabels;
+  }
+
+  bool HasTargetValues() const
+  {
+    return (targets != 0);
+  }
+
+  unsigned int Count() const
+  {
+    return numPoints;
+  }
+
+  /// <returns>A tuple containing min and max over the specified dimension of the data</returns>
+  std::pair<float, float> GetRange(int dimension) const
+  {
+    if (Count() < 0)
+      throw std::runtime_error("Insufficient features to compute range.");
+
+    if (dimension < 0 || dimension> numFeatures)
+      throw std::runtime_error("Insufficient features to compute range.");
+
+    float min = GetDataPoint(0)[dimension];
+    float max = GetDataPoint(0)[dimension];
+
+    for (unsigned int i =1; i < numPoints; i++)
+    {
+      if (GetDataPoint(i)[dimension]  < min)
+        min = GetDataPoint(i)[dimension];
+      else if (GetDataPoint(i)[dimension] > max)
+        max = GetDataPoint(i)[dimension];
+    }
+
+    return std::pair<float, float>(min, max);
+  }
+
+  /// <summary>
+  /// Get the range of target values (or raise an exception if these data
+  /// do not have associated target values).
+  /// </summary>
+  /// <returns>A tuple containing the min and max target value for the data</returns>
+  std::pair<float, float> GetTargetRange() const
+  {
+    if (!HasTargetValues())
+      throw std::runtime_error("Data have no associated target values.");
+
+    float min = targets[0];
+    float max = targets[0];
+
+    for (unsigned int i = 1; i < numPoints; i++)
+    {
+      if (targets[i] < min)
+        min = targets[i];
+      else if (targets[i] > max)
+        max = targets[i];
+    }
+
+    return std::pair<float, float>(min, max);
+  }
+
+  unsigned int Dimensions() const
+  {
+    return numFeatures;
+  }
+
+  /// Returns Pointer to the first element of the data point.
+  const float* GetDataPoint(unsigned int i) const
+  {   
+    return &features[(size_t)i*numFeatures];
+  }
+
+  // Stores a feature-major copy of the features, doubling the memory used.
+  // Reading one dimension of many data points, as axis-aligned features
+  // do, is then contiguous instead of strided by Dimensions().
+  void TransposeFeatures()
+  {
+    const unsigned int blockSize = 64;
+
+    transposed.resize((size_t)numFeatures * numPoints);
+
+    // Blocks of data points, so that the rows written stay in cache.
+    for (unsigned int first = 0; first < numPoints; first += blockSize)
+    {
+      unsigned int last = std::min(first + blockSize, numPoints);
+
+      for (unsigned int d = 0; d < numFeatures; d++)
+      {
+        float* row = &transposed[(size_t)d*numPoints];
+        for (unsigned int i = first; i < last; i++)
+          row[i] = features[(size_t)i*numFeatures + d];
+      }
+    }
+  }
+
+  bool IsTransposed() const
+  {
+    return !transposed.empty();
+  }
+
+  // Feature d of all data points, if IsTransposed().
+  const float* GetDimension(unsigned int d) const
+  {
+    return &transposed[(size_t)d*numPoints];
+  }
+
+  // Feature d of data point i, from the feature-major copy if there is one.
+  float GetFeature(unsigned int i, unsigned int d) const
+  {
+    if (IsTransposed())
+      return transposed[(size_t)d*numPoints + i];
+
+    return features[(size_t)i*numFeatures + d];
+  }
+
+  unsigned int GetIntegerLabel(unsigned int i) const
+  {
+    switch (labelType) {
+      case UInt8Labels:  return ((const unsigned char*)labels)[i];
+      case UInt16Labels: return ((const unsigned short*)labels)[i];
+      default:           return ((const unsigned int*)labels)[i];
+    }
+  }
+
+  float GetTarget(int i) const
+  {
+    return targets[i];
+  }
+
+  Stats GetStats(int d) const {
+
+    float mean = GetFeature(0, d);
+    for (unsigned int i = 1; i < numPoints; i++)
+    {
+      mean += GetFeature(i, d);
+    } 
+
+    mean /= numPoints;
+
+    float stddev = (GetFeature(0, d) - mean)*(GetFeature(0, d) - mean);
+    for (unsigned int i = 1; i < numPoints; i++)
+    {
+      stddev += (GetFeature(i, d) - mean)*(GetFeature(i, d) - mean);
+    } 
+
+    stddev /= numPoints;
+    stddev = sqrt(stddev);
+
+    return Stats(mean,stddev);
+  }
+
+public:
+  // features[example_id*numFeatures + feature_id]
+  const float* features;
+  const void* labels;
+  LabelType labelType;
+  const float* targets;
+  unsigned int numPoints;
+  unsigned int numLabels;
+  unsigned int numFeatures;
+  static const int UnknownClassLabel = -1;
+
+  // Empty, or transposed[feature_id*numPoints + example_id]
+  std::vector<float> transposed;
+
+  // The features as given, features is null unless they are single.
+  const void* rawFeatures;
+  FeatureType featureType;
+
+private:
+  template<typename T>
+  void Convert(const T* source, size_t size, std::vector<float>& buffer)
+  {
+    for (size_t k = 0; k < size; k++)
+      buffer[k] = (float)source[k];
+
+    features = size > 0 ? &buffer[0] : 0;
+  }
 };
\ No newline at end of file
@@ -1,153 +1,357 @@
-#pragma once
-
-#include "sherwood_mex.h"
-#include <string>
-#include <math.h>
-
-// This file defines some IFeatureResponse implementations used by the example code in
-// Classification.h, DensityEstimation.h, etc. Note we represent IFeatureResponse
-// instances using simple structs so that all tree data can be stored
-// contiguously in a linear array.
-
-namespace MicrosoftResearch { namespace Cambridge { namespace Sherwood
-{
-  class Random;
-
-  // Generate a normal distributed number given a uniform random number generator
-  // Box-muller transform.
-  float randn(Random& random) 
-  {
-    float u = (2*random.NextDouble()) - 1; 
-    float v = (2*random.NextDouble()) - 1; 
-    float r = u * u + v * v;
-
-    if (r == 0 || r > 1) return randn(random);
-
-    float c = sqrt(-2 * log(r) / r);
-    return u * c;
-  }
-
-  class AxisAlignedFeatureResponse
-  {
-    unsigned int axis;
-
-  public:
-    AxisAlignedFeatureResponse() 
-    : axis(-1)
-    {}
-
-    AxisAlignedFeatureResponse(unsigned int axis)
-    : axis(axis)
-    {}
-
-    static AxisAlignedFeatureResponse CreateRandom( Random& random, 
-                                                    unsigned int dimensions,
-                                                    std::vector<Stats>& featureStats)
-    {
-      return AxisAlignedFeatureResponse(random.Next(0, dimensions));
-    }
-
-    unsigned int Axis() const
-    {
-      return axis;
-    }
-
-    // IFeatureResponse implementation
-    float GetResponse(const IDataPointCollection& data, unsigned int sampleIndex) const  {
-      const DataPointCollection& concreteData = (DataPointCollection&)(data);
-      return concreteData.GetDataPoint(sampleIndex)[axis];
-    }
-    
-    std::string ToString() const;
-  };
-
-  class RandomHyperplaneFeatureResponse
-  {
-  public:
-    unsigned dimensions;
-    std::vector<float> n;
-
-    RandomHyperplaneFeatureResponse() {
-      dimensions = 0;      
-    }
-
-    RandomHyperplaneFeatureResponse(  Random& random, 
-                                      unsigned int dimensions,
-                                      std::vector<Stats> featureStats) 
-    : dimensions(dimensions)
-    {
-      n.resize(dimensions);
-
-      // Normal distributed numbers to gives an unbiased random unit vector.
-      for (unsigned int c = 0; c < dimensions; c++) {
-        n[c] = randn(random); 
-      }
-    }
-
-    static RandomHyperplaneFeatureResponse CreateRandom(Random& random, 
-                                                        unsigned int dimensions,
-                                                        std::vector<Stats>& featureStats)
-    {
-      return RandomHyperplaneFeatureResponse(random, dimensions, featureStats);
-    }
-
-    // IFeatureResponse implementation
-    float GetResponse(const IDataPointCollection& data, unsigned int index) const
-    {
-      const DataPointCollection& concreteData = (const DataPointCollection&)(data);   
-      
-      float response = n[0] * concreteData.GetDataPoint(index)[0];
-      for (unsigned int c = 1; c < dimensions; c++) {
-        response += n[c] * concreteData.GetDataPoint(index)[c];  
-      }
-
-      return response;
-    }
-  };  
-
-  class RandomHyperplaneFeatureResponseNormalized
-  {
-  public:
-    unsigned dimensions;
-    std::vector<float> n;
-    std::vector<Stats> featureStats;
-
-    RandomHyperplaneFeatureResponseNormalized() {
-      dimensions = 0;      
-    }
-
-    RandomHyperplaneFeatureResponseNormalized(  Random& random, 
-                                      unsigned int dimensions,
-                                      std::vector<Stats> featureStats) 
-    : dimensions(dimensions), featureStats(featureStats)
-    {
-      n.resize(dimensions);
-
-      // Normal distributed numbers to gives an unbiased random unit vector.
-      for (unsigned int c = 0; c < dimensions; c++) {
-        n[c] = randn(random); 
-      }
-    }
-
-    static RandomHyperplaneFeatureResponseNormalized CreateRandom(Random& random, 
-                                                        unsigned int dimensions,
-                                                        std::vector<Stats>& featureStats)
-    {
-      return RandomHyperplaneFeatureResponseNormalized(random, dimensions, featureStats);
-    }
-
-    // IFeatureResponse implementation
-    float GetResponse(const IDataPointCollection& data, unsigned int index) const
-    {
-      const DataPointCollection& concreteData = (const DataPointCollection&)(data);   
-      
-      float response = n[0] * ((concreteData.GetDataPoint(index)[0] - featureStats[0].mean) / featureStats[0].stdev);
-      for (unsigned int c = 1; c < dimensions; c++) {
-        response += n[c] * ((concreteData.GetDataPoint(index)[c] - featureStats[c].mean) / featureStats[c].stdev);  
-      }
-
-      return response;
-    }
-  };	
-
+#pragma once
+
+#include "sherwood_core.h"
+#include <string>
+#include <math.h>
+#include <cassert>
+
+// This file defines some IFeatureResponse implementations used by the example code in
+// Classification.h, DensityEstimation.h, etc. Note we represent IFeatureResponse
+// instances using simple structs so that all tree data can be stored
+// contiguously in a linear array.
+
+namespace MicrosoftResearch { namespace Cambridge { namespace Sherwood
+{
+  class Random;
+
+  // Generate a normal distributed number given a uniform random number generator
+  // Box-muller transform.
+  float randn(Random& random) 
+  {
+    float u = (2*random.NextDouble()) - 1; 
+    float v = (2*random.NextDouble()) - 1; 
+    float r = u * u + v * v;
+
+    if (r == 0 || r > 1) return randn(random);
+
+    float c = sqrt(-2 * log(r) / r);
+    return u * c;
+  }
+
+  class AxisAlignedFeatureResponse
+  {
+    unsigned int axis;
+
+  public:
+    AxisAlignedFeatureResponse() 
+    : axis(-1)
+    {}
+
+    AxisAlignedFeatureResponse(unsigned int axis)
+    : axis(axis)
+    {}
+
+    static AxisAlignedFeatureResponse CreateRandom( Random& random, 
+                                                    unsigned int dimensions,
+                                                    std::vector<Stats>& featureStats)
+    {
+      return AxisAlignedFeatureResponse(random.Next(0, dimensions));
+    }
+
+    static void CreateRandom(Random& random, unsigned int dimensions,
+                             const std::vector<Stats>& featureStats, AxisAlignedFeatureResponse& feature)
+    {
+      feature.axis = random.Next(0, dimensions);
+    }
+
+    unsigned int Axis() const
+    {
+      return axis;
+    }
+
+    // Training data is transposed for features reading one dimension.
+    static bool FeatureMajor()
+    {
+      return true;
+    }
+
+    // IFeatureResponse implementation
+    float GetResponse(const IDataPointCollection& data, unsigned int sampleIndex) const  {
+      const DataPointCollection& concreteData = (DataPointCollection&)(data);
+      return concreteData.GetFeature(sampleIndex, axis);
+    }
+
+    // Responses of the data points indices[0], ..., indices[count-1].
+    void GetResponses(const DataPointCollection& data, const unsigned int* indices,
+                      unsigned int count, float* responses) const
+    {
+      if (data.IsTransposed())
+      {
+        const float* values = data.GetDimension(axis);
+        for (unsigned int k = 0; k < count; k++)
+          responses[k] = values[indices[k]];
+        return;
+      }
+
+      for (unsigned int k = 0; k < count; k++)
+        responses[k] = data.GetDataPoint(indices[k])[axis];
+    }
+    
+    std::string ToString() const;
+  };
+
+  class RandomHyperplaneFeatureResponse
+  {
+  public:
+    unsigned dimensions;
+    std::vector<float> n;
+
+    RandomHyperplaneFeatureResponse() {
+      dimensions = 0;      
+    }
+
+    RandomHyperplaneFeatureResponse(  Random& random, 
+                                      unsigned int dimensions,
+                                      std::vector<Stats> featureStats) 
+    : dimensions(dimensions)
+    {
+      n.resize(dimensions);
+
+      // Normal distributed numbers to gives an unbiased random unit vector.
+      for (unsigned int c = 0; c < dimensions; c++) {
+        n[c] = randn(random); 
+      }
+    }
+
+    static RandomHyperplaneFeatureResponse CreateRandom(Random& random, 
+                                                        unsigned int dimensions,
+                                                        std::vector<Stats>& featureStats)
+    {
+      return RandomHyperplaneFeatureResponse(random, dimensions, featureStats);
+    }
+
+    // As the constructor, reusing the coefficients of feature.
+    static void CreateRandom(Random& random, unsigned int dimensions,
+                             const std::vector<Stats>& featureStats, RandomHyperplaneFeatureResponse& feature)
+    {
+      feature.dimensions = dimensions;
+      feature.n.resize(dimensions);
+
+      for (unsigned int c = 0; c < dimensions; c++) {
+        feature.n[c] = randn(random);
+      }
+    }
+
+    // Hyperplanes read whole data points.
+    static bool FeatureMajor()
+    {
+      return false;
+    }
+
+    // IFeatureResponse implementation
+    float GetResponse(const IDataPointCollection& data, unsigned int index) const
+    {
+      const DataPointCollection& concreteData = (const DataPointCollection&)(data);   
+      
+      float response = n[0] * concreteData.GetDataPoint(index)[0];
+      for (unsigned int c = 1; c < dimensions; c++) {
+        response += n[c] * concreteData.GetDataPoint(index)[c];  
+      }
+
+      return response;
+    }
+
+    // As GetResponse for indices[0], ..., indices[count-1], with the same
+    // order of operations.
+    void GetResponses(const DataPointCollection& data, const unsigned int* indices,
+                      unsigned int count, float* responses) const
+    {
+      const unsigned int block = 8;
+      const float* w = &n[0];
+      const float* x[block];
+
+      // Blocks of data points are evaluated together, one dimension at a
+      // time, so that independent sums are in flight.
+      unsigned int k = 0;
+      for (; k + block <= count; k += block)
+      {
+        float response[block];
+        for (unsigned int j = 0; j < block; j++)
+        {
+          x[j] = data.GetDataPoint(indices[k + j]);
+          response[j] = w[0] * x[j][0];
+        }
+
+        for (unsigned int c = 1; c < dimensions; c++)
+          for (unsigned int j = 0; j < block; j++)
+            response[j] += w[c] * x[j][c];
+
+        for (unsigned int j = 0; j < block; j++)
+          responses[k + j] = response[j];
+      }
+
+      for (; k < count; k++)
+      {
+        const float* point = data.GetDataPoint(indices[k]);
+
+        float response = w[0] * point[0];
+        for (unsigned int c = 1; c < dimensions; c++)
+          response += w[c] * point[c];
+
+        responses[k] = response;
+      }
+    }
+  };  
+
+  class RandomHyperplaneFeatureResponseNormalized
+  {
+  public:
+    unsigned dimensions;
+    std::vector<float> n;
+    std::vector<Stats> featureStats;
+
+    RandomHyperplaneFeatureResponseNormalized() {
+      dimensions = 0;      
+    }
+
+    RandomHyperplaneFeatureResponseNormalized(  Random& random, 
+                                      unsigned int dimensions,
+                                      const std::vector<Stats>& featureStats) 
+    : dimensions(dimensions), featureStats(featureStats)
+    {
+      n.resize(dimensions);
+
+      // Normal distributed numbers to gives an unbiased random unit vector.
+      for (unsigned int c = 0; c < dimensions; c++) {
+        n[c] = randn(random); 
+      }
+    }
+
+    static RandomHyperplaneFeatureResponseNormalized CreateRandom(Random& random, 
+                                                        unsigned int dimensions,
+                                                        std::vector<Stats>& featureStats)
+    {
+      return RandomHyperplaneFeatureResponseNormalized(random, dimensions, featureStats);
+    }
+
+    // As the constructor, reusing the coefficients and statistics of feature.
+    static void CreateRandom(Random& random, unsigned int dimensions,
+                             const std::vector<Stats>& featureStats, RandomHyperplaneFeatureResponseNormalized& feature)
+    {
+      feature.dimensions = dimensions;
+      feature.featureStats.assign(featureStats.begin(), featureStats.end());
+      feature.n.resize(dimensions);
+
+      for (unsigned int c = 0; c < dimensions; c++) {
+        feature.n[c] = randn(random);
+      }
+    }
+
+    // Hyperplanes read whole data points.
+    static bool FeatureMajor()
+    {
+      return false;
+    }
+
+    // IFeatureResponse implementation
+    float GetResponse(const IDataPointCollection& data, unsigned int index) const
+    {
+      const DataPointCollection& concreteData = (const DataPointCollection&)(data);   
+      
+      float response = n[0] * ((concreteData.GetDataPoint(index)[0] - featureStats[0].mean) / featureStats[0].stdev);
+      for (unsigned int c = 1; c < dimensions; c++) {
+        response += n[c] * ((concreteData.GetDataPoint(index)[c] - featureStats[c].mean) / featureStats[c].stdev);  
+      }
+
+      return response;
+    }
+
+    // As GetResponse for indices[0], ..., indices[count-1], with the same
+    // order of operations.
+    void GetResponses(const DataPointCollection& data, const unsigned int* indices,
+                      unsigned int count, float* responses) const
+    {
+      const unsigned int block = 8;
+      const float* w = &n[0];
+      const Stats* stats = &featureStats[0];
+      const float* x[block];
+
+      // As RandomHyperplaneFeatureResponse::GetResponses.
+      unsigned int k = 0;
+      for (; k + block <= count; k += block)
+      {
+        float response[block];
+        for (unsigned int j = 0; j < block; j++)
+        {
+          x[j] = data.GetDataPoint(indices[k + j]);
+          response[j] = w[0] * ((x[j][0] - stats[0].mean) / stats[0].stdev);
+        }
+
+        for (unsigned int c = 1; c < dimensions; c++)
+          for (unsigned int j = 0; j < block; j++)
+            response[j] += w[c] * ((x[j][c] - stats[c].mean) / stats[c].stdev);
+
+        for (unsigned int j = 0; j < block; j++)
+          responses[k + j] = response[j];
+      }
+
+      for (; k < count; k++)
+      {
+        const float* point = data.GetDataPoint(indices[k]);
+
+        float response = w[0] * ((point[0] - stats[0].mean) / stats[0].stdev);
+        for (unsigned int c = 1; c < dimensions; c++)
+          response += w[c] * ((point[c] - stats[c].mean) / stats[c].stdev);
+
+        responses[k] = response;
+      }
+    }
+  };	
+
+  // Sets feature to read dimension axis, for training features that read
+  // one dimension (FeatureMajor) on distinct dimensions.
+  void SetFeatureAxis(AxisAlignedFeatureResponse& feature, unsigned int axis)
+  {
+    feature = AxisAlignedFeatureResponse(axis);
+  }
+
+  template<typename F>
+  void SetFeatureAxis(F& feature, unsigned int axis)
+  {
+    assert(!"Only features reading one dimension have an axis.");
+  }
+
+  // Adds weight to usage[d] for the dimensions d the feature uses. For
+  // hyperplanes the weight is spread in proportion to the absolute
+  // coefficients (of the standardized features when normalized).
+  void AddFeatureUsage(const AxisAlignedFeatureResponse& feature, double weight, std::vector<double>& usage)
+  {
+    if (usage.size() <= feature.Axis()) {
+      usage.resize(feature.Axis() + 1, 0.0);
+    }
+
+    usage[feature.Axis()] += weight;
+  }
+
+  template<typename F>
+  void AddHyperplaneUsage(const F& feature, double weight, std::vector<double>& usage)
+  {
+    if (usage.size() < feature.dimensions) {
+      usage.resize(feature.dimensions, 0.0);
+    }
+
+    double sum = 0;
+    for (unsigned int d = 0; d < feature.dimensions; d++) {
+      sum += fabs(feature.n[d]);
+    }
+
+    if (sum == 0) {
+      return;
+    }
+
+    for (unsigned int d = 0; d < feature.dimensions; d++) {
+      usage[d] += weight * fabs(feature.n[d]) / sum;
+    }
+  }
+
+  void AddFeatureUsage(const RandomHyperplaneFeatureResponse& feature, double weight, std::vector<double>& usage)
+  {
+    AddHyperplaneUsage(feature, weight, usage);
+  }
+
+  void AddFeatureUsage(const RandomHyperplaneFeatureResponseNormalized& feature, double weight, std::vector<double>& usage)
+  {
+    AddHyperplaneUsage(feature, weight, usage);
+  }
+
 } } }
\ No newline at end of file
@@ -29,9 +29,12 @@ public:
       return (double)(Next())/m;
     }
  
+    // The low bits of the generator have short periods, so the high bits
+    // are used.
     int Next(int minValue, int maxValue)
     {
-      return minValue + Next()%(maxValue-minValue);
+      int value = minValue + (int)(NextDouble()*(maxValue-minValue));
+      return value < maxValue ? value : maxValue - 1;
     }
 
 private:
@@ -1,92 +1,123 @@
-#pragma once
-#include "StatisticsAggregators.h"
-#include "Node.h"
-
-// Every FeatureRespone which allocates on the heap needs 
-// a specialized serializer and deserializer.
-namespace MicrosoftResearch { namespace Cambridge { namespace Sherwood
-{
-  template<typename T>
-  void  binary_write(std::ostream& o, const T& value)
-  {
-    o.write(reinterpret_cast<const char*>(&value), sizeof(T));
-  }
-
-  template<typename T>
-  void binary_read(std::istream& i, T& value) {
-      i.read(reinterpret_cast<char*>(&value), sizeof(T));
-  }
-
-  template<> 
-  void Serialize_(std::ostream& o, const RandomHyperplaneFeatureResponseNormalized& feature)
-  {
-    binary_write(o, feature.dimensions);  
-
-    for (unsigned int i = 0; i < feature.dimensions; i++) {
-      binary_write(o, feature.n[i]);
-      binary_write(o, feature.featureStats[i].mean) ;
-      binary_write(o, feature.featureStats[i].stdev) ;
-    }
-  }
-
-  template<> 
-    void Deserialize_(std::istream& o, RandomHyperplaneFeatureResponseNormalized& feature)
-    { 
-      binary_read(o, feature.dimensions);
-      feature.n.resize(feature.dimensions);
-      feature.featureStats.resize(feature.dimensions);
-
-      for (unsigned int i = 0; i < feature.dimensions; i++) {
-        binary_read(o, feature.n[i]);
-        binary_read(o, feature.featureStats[i].mean) ;
-        binary_read(o, feature.featureStats[i].stdev) ;
-      }
-    }
-
-  template<> 
-  void Serialize_(std::ostream& o, const RandomHyperplaneFeatureResponse& feature)
-  {
-    binary_write(o, feature.dimensions);  
-
-    for (unsigned int i = 0; i < feature.dimensions; i++) {
-      binary_write(o, feature.n[i]);
-    }
-  }
-
-  template<> 
-    void Deserialize_(std::istream& o, RandomHyperplaneFeatureResponse& feature)
-    { 
-      binary_read(o, feature.dimensions);
-      feature.n.resize(feature.dimensions);
-
-      for (unsigned int i = 0; i < feature.dimensions; i++) {
-        binary_read(o, feature.n[i]);
-      }
-    }
-
-
-  template<>
-  void Serialize_(std::ostream& o, const HistogramAggregator& S)
-  {
-    binary_write(o, S.binCount_);  
-    binary_write(o, S.sampleCount_);  ;  
-
-    for (unsigned int i = 0; i < S.binCount_; i++) {
-      binary_write(o, S.bins_[i]) ;
-    }
-  }
-
-  template<> 
-  void Deserialize_(std::istream& o, HistogramAggregator& S)
-  { 
-    binary_read(o, S.binCount_);
-    binary_read(o, S.sampleCount_);
-    S.bins_.resize(S.binCount_);
-
-    for (unsigned int i = 0; i < S.binCount_; i++) {
-      binary_read(o, S.bins_[i]);
-    }
-  }
-}
-}
-}
+#pragma once
+#include "StatisticsAggregators.h"
+#include "Node.h"
+
+// Every FeatureRespone which allocates on the heap needs 
+// a specialized serializer and deserializer.
+namespace MicrosoftResearch { namespace Cambridge { namespace Sherwood
+{
+  template<typename T>
+  void  binary_write(std::ostream& o, const T& value)
+  {
+    o.write(reinterpret_cast<const char*>(&value), sizeof(T));
+  }
+
+  template<typename T>
+  void binary_read(std::istream& i, T& value) {
+      i.read(reinterpret_cast<char*>(&value), sizeof(T));
+  }
+
+  template<> 
+  void Serialize_(std::ostream& o, const RandomHyperplaneFeatureResponseNormalized& feature)
+  {
+    binary_write(o, feature.dimensions);  
+
+    for (unsigned int i = 0; i < feature.dimensions; i++) {
+      binary_write(o, feature.n[i]);
+      binary_write(o, feature.featureStats[i].mean) ;
+      binary_write(o, feature.featureStats[i].stdev) ;
+    }
+  }
+
+  template<> 
+    void Deserialize_(std::istream& o, RandomHyperplaneFeatureResponseNormalized& feature)
+    { 
+      binary_read(o, feature.dimensions);
+      feature.n.resize(feature.dimensions);
+      feature.featureStats.resize(feature.dimensions);
+
+      for (unsigned int i = 0; i < feature.dimensions; i++) {
+        binary_read(o, feature.n[i]);
+        binary_read(o, feature.featureStats[i].mean) ;
+        binary_read(o, feature.featureStats[i].stdev) ;
+      }
+    }
+
+  template<> 
+  void Serialize_(std::ostream& o, const RandomHyperplaneFeatureResponse& feature)
+  {
+    binary_write(o, feature.dimensions);  
+
+    for (unsigned int i = 0; i < feature.dimensions; i++) {
+      binary_write(o, feature.n[i]);
+    }
+  }
+
+  template<> 
+    void Deserialize_(std::istream& o, RandomHyperplaneFeatureResponse& feature)
+    { 
+      binary_read(o, feature.dimensions);
+      feature.n.resize(feature.dimensions);
+
+      for (unsigned int i = 0; i < feature.dimensions; i++) {
+        binary_read(o, feature.n[i]);
+      }
+    }
+
+
+  // Dense histograms are written as binCount, sampleCount, bins. Sparse
+  // histograms (more than HistogramAggregator::SparseBinThreshold classes)
+  // are written as binCount, sampleCount, number of pairs, (class, count) pairs.
+  template<>
+  void Serialize_(std::ostream& o, const HistogramAggregator& S)
+  {
+    binary_write(o, S.binCount_);  
+    binary_write(o, S.sampleCount_);  ;  
+
+    if (S.IsSparse()) {
+      unsigned int pairCount = (unsigned int)S.sparseBins_.size();
+      binary_write(o, pairCount);
+
+      for (unsigned int i = 0; i < pairCount; i++) {
+        binary_write(o, S.sparseBins_[i].first);
+        binary_write(o, S.sparseBins_[i].second);
+      }
+      return;
+    }
+
+    const unsigned int* bins = S.Bins();
+    for (unsigned int i = 0; i < S.binCount_; i++) {
+      binary_write(o, bins[i]) ;
+    }
+  }
+
+  template<> 
+  void Deserialize_(std::istream& o, HistogramAggregator& S)
+  { 
+    binary_read(o, S.binCount_);
+    binary_read(o, S.sampleCount_);
+
+    if (S.IsSparse()) {
+      unsigned int pairCount = 0;
+      binary_read(o, pairCount);
+      S.bins_.clear();
+      S.sparseBins_.resize(pairCount);
+
+      for (unsigned int i = 0; i < pairCount; i++) {
+        binary_read(o, S.sparseBins_[i].first);
+        binary_read(o, S.sparseBins_[i].second);
+      }
+      return;
+    }
+
+    std::fill(S.inlineBins_, S.inlineBins_ + HistogramAggregator::InlineBinCapacity, 0u);
+    S.bins_.resize(S.IsInline() ? 0 : S.binCount_);
+
+    unsigned int* bins = S.Bins();
+    for (unsigned int i = 0; i < S.binCount_; i++) {
+      binary_read(o, bins[i]);
+    }
+  }
+}
+}
+}
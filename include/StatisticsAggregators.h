@@ -1,117 +1,420 @@
-#pragma once
-#include <math.h>
-#include <limits>
-#include "sherwood_mex.h"
-
-namespace MicrosoftResearch { namespace Cambridge { namespace Sherwood
-{
-  struct HistogramAggregator
-  {
-  public:
-    std::vector<unsigned int> bins_;
-    unsigned int binCount_;
-    unsigned int sampleCount_;
-
-  public:
-
-    double Entropy() const
-    {
-      if (sampleCount_ == 0)
-        return 0.0;
-
-      double result = 0.0;
-      for (unsigned int b = 0; b < BinCount(); b++)
-      {
-        double p = (double)bins_[b] / (double)sampleCount_;
-        result -= p == 0.0 ? 0.0 : p * log(p)/log(2.0);
-      }
-
-      return result;
-    }
-
-    HistogramAggregator()
-    {
-      binCount_ = 0;
-      sampleCount_ = 0;
-    }
-
-    HistogramAggregator(unsigned int nClasses) 
-    {
-      binCount_ = nClasses;
-      
-      bins_.resize(nClasses); 
-      for(unsigned int b=0; b<binCount_; b++)
-        bins_[b] = 0;
-
-      sampleCount_ = 0;
-    }
-
-    float GetProbability(unsigned int classIndex) const
-    {
-      return (float)(bins_[classIndex]) / sampleCount_;
-    }
-
-    unsigned int BinCount() const {
-      return binCount_; 
-    }
-    unsigned int SampleCount() const { 
-      return sampleCount_; 
-    }
-
-    unsigned int FindTallestBinIndex() const
-    {
-      unsigned int maxCount = bins_[0];
-      unsigned int tallestBinIndex = 0;
-
-      for (unsigned int i = 1; i < BinCount(); i++)
-      {
-        if (bins_[i] > maxCount)
-        {
-          maxCount = bins_[i];
-          tallestBinIndex = i;
-        }
-      }
-
-      return tallestBinIndex;
-    }
-
-    // IStatisticsAggregator implementation
-    void Clear()
-    {
-      for (unsigned int b = 0; b < BinCount(); b++)
-        bins_[b] = 0;
-
-      sampleCount_ = 0;
-    }
-
-    void Aggregate(const IDataPointCollection& data, unsigned int index)
-    {
-      const DataPointCollection& concreteData = (const DataPointCollection&)(data);
-
-      bins_[concreteData.GetIntegerLabel(index)]++;
-      sampleCount_ += 1;
-    }
-
-    void Aggregate(const HistogramAggregator& aggregator)
-    {
-      assert(aggregator.BinCount() == BinCount());
-   
-      for (unsigned int b = 0; b < BinCount(); b++)
-        bins_[b] += aggregator.bins_[b];
-
-      sampleCount_ += aggregator.sampleCount_;
-    }
-
-    HistogramAggregator DeepClone() const
-    {
-      HistogramAggregator result(BinCount());
-
-      for (unsigned int b = 0; b < BinCount(); b++)
-        result.bins_[b] = bins_[b];
-
-      result.sampleCount_ = sampleCount_;
-
-      return result;
-    }
-  };
-} } }
\ No newline at end of file
+#pragma once
+#include <math.h>
+#include <limits>
+#include <cassert>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include "sherwood_core.h"
+
+namespace MicrosoftResearch { namespace Cambridge { namespace Sherwood
+{
+  // Class histogram. With many classes only a few are present in each node,
+  // so above SparseBinThreshold classes the histogram is stored as
+  // (class, count) pairs sorted by class. Split evaluation, copies and leaf
+  // storage are then proportional to the number of classes actually present.
+  //
+  // Up to InlineBinCapacity classes, as for most models, the bins are
+  // stored in the aggregator itself: copies do not allocate and clearing
+  // and merging run over a fixed number of bins (those above BinCount()
+  // are kept at zero), which the compiler unrolls and vectorizes.
+  struct HistogramAggregator
+  {
+  public:
+    typedef std::pair<unsigned int, unsigned int> SparseBin;
+
+    static const unsigned int InlineBinCapacity = 16;
+    static const unsigned int SparseBinThreshold = 256;
+
+    unsigned int inlineBins_[InlineBinCapacity];
+    std::vector<unsigned int> bins_;
+    std::vector<SparseBin> sparseBins_;
+    unsigned int binCount_;
+    unsigned int sampleCount_;
+
+  public:
+
+    double Entropy() const
+    {
+      if (sampleCount_ == 0)
+        return 0.0;
+
+      double result = 0.0;
+      if (IsSparse())
+      {
+        for (unsigned int b = 0; b < sparseBins_.size(); b++)
+        {
+          double p = (double)sparseBins_[b].second / (double)sampleCount_;
+          result -= p * log(p)/log(2.0);
+        }
+
+        return result;
+      }
+
+      const unsigned int* bins = Bins();
+      for (unsigned int b = 0; b < BinCount(); b++)
+      {
+        double p = (double)bins[b] / (double)sampleCount_;
+        result -= p == 0.0 ? 0.0 : p * log(p)/log(2.0);
+      }
+
+      return result;
+    }
+
+    HistogramAggregator()
+    {
+      binCount_ = 0;
+      sampleCount_ = 0;
+      std::fill(inlineBins_, inlineBins_ + InlineBinCapacity, 0u);
+    }
+
+    HistogramAggregator(unsigned int nClasses)
+    {
+      binCount_ = nClasses;
+      std::fill(inlineBins_, inlineBins_ + InlineBinCapacity, 0u);
+
+      if (!IsInline() && !IsSparse())
+        bins_.assign(nClasses, 0);
+
+      sampleCount_ = 0;
+    }
+
+    bool IsInline() const
+    {
+      return binCount_ <= InlineBinCapacity;
+    }
+
+    bool IsSparse() const
+    {
+      return binCount_ > SparseBinThreshold;
+    }
+
+    // The dense bins, BinCount() of them.
+    unsigned int* Bins()
+    {
+      return IsInline() ? inlineBins_ : &bins_[0];
+    }
+
+    const unsigned int* Bins() const
+    {
+      return IsInline() ? inlineBins_ : &bins_[0];
+    }
+
+    unsigned int GetCount(unsigned int classIndex) const
+    {
+      if (!IsSparse())
+        return Bins()[classIndex];
+
+      std::vector<SparseBin>::const_iterator it = std::lower_bound(
+        sparseBins_.begin(), sparseBins_.end(), SparseBin(classIndex, 0));
+
+      if (it == sparseBins_.end() || it->first != classIndex)
+        return 0;
+
+      return it->second;
+    }
+
+    float GetProbability(unsigned int classIndex) const
+    {
+      return (float)(GetCount(classIndex)) / sampleCount_;
+    }
+
+    unsigned int BinCount() const {
+      return binCount_;
+    }
+    unsigned int SampleCount() const {
+      return sampleCount_;
+    }
+
+    unsigned int FindTallestBinIndex() const
+    {
+      if (IsSparse())
+      {
+        unsigned int maxCount = 0;
+        unsigned int tallestBinIndex = 0;
+
+        for (unsigned int i = 0; i < sparseBins_.size(); i++)
+        {
+          if (sparseBins_[i].second > maxCount)
+          {
+            maxCount = sparseBins_[i].second;
+            tallestBinIndex = sparseBins_[i].first;
+          }
+        }
+
+        return tallestBinIndex;
+      }
+
+      const unsigned int* bins = Bins();
+      unsigned int maxCount = bins[0];
+      unsigned int tallestBinIndex = 0;
+
+      for (unsigned int i = 1; i < BinCount(); i++)
+      {
+        if (bins[i] > maxCount)
+        {
+          maxCount = bins[i];
+          tallestBinIndex = i;
+        }
+      }
+
+      return tallestBinIndex;
+    }
+
+    // Adds the bin counts to out[0], ..., out[BinCount()-1].
+    template<typename T>
+    void AccumulateCounts(T* out) const
+    {
+      if (IsSparse())
+      {
+        for (unsigned int i = 0; i < sparseBins_.size(); i++)
+          out[sparseBins_[i].first] += sparseBins_[i].second;
+        return;
+      }
+
+      const unsigned int* bins = Bins();
+      for (unsigned int b = 0; b < BinCount(); b++)
+        out[b] += bins[b];
+    }
+
+    // Adds the class probabilities to out[0], ..., out[BinCount()-1].
+    template<typename T>
+    void AccumulateProbabilities(T* out) const
+    {
+      if (sampleCount_ == 0)
+        return;
+
+      T scale = T(1) / sampleCount_;
+
+      if (IsSparse())
+      {
+        for (unsigned int i = 0; i < sparseBins_.size(); i++)
+          out[sparseBins_[i].first] += scale * sparseBins_[i].second;
+        return;
+      }
+
+      const unsigned int* bins = Bins();
+      for (unsigned int b = 0; b < BinCount(); b++)
+        out[b] += scale * bins[b];
+    }
+
+    // IStatisticsAggregator implementation
+    void Clear()
+    {
+      if (IsSparse())
+        sparseBins_.clear();
+
+      if (IsInline())
+        std::fill(inlineBins_, inlineBins_ + InlineBinCapacity, 0u);
+      else
+        std::fill(bins_.begin(), bins_.end(), 0u);
+
+      sampleCount_ = 0;
+    }
+
+    void Aggregate(const IDataPointCollection& data, unsigned int index)
+    {
+      const DataPointCollection& concreteData = (const DataPointCollection&)(data);
+
+      unsigned int label = concreteData.GetIntegerLabel(index);
+      sampleCount_ += 1;
+
+      if (!IsSparse())
+      {
+        Bins()[label]++;
+        return;
+      }
+
+      std::vector<SparseBin>::iterator it = std::lower_bound(
+        sparseBins_.begin(), sparseBins_.end(), SparseBin(label, 0));
+
+      if (it != sparseBins_.end() && it->first == label)
+        it->second++;
+      else
+        sparseBins_.insert(it, SparseBin(label, 1));
+    }
+
+    // Aggregates the data points indices[0], ..., indices[count-1].
+    void Aggregate(const DataPointCollection& data, const unsigned int* indices, unsigned int count)
+    {
+      if (IsSparse())
+      {
+        for (unsigned int k = 0; k < count; k++)
+          Aggregate(data, indices[k]);
+        return;
+      }
+
+      // The label type is dispatched on once, not for every data point.
+      unsigned int* bins = Bins();
+      switch (data.labelType) {
+        case DataPointCollection::UInt8Labels:
+          CountLabels((const unsigned char*)data.labels, indices, count, bins);
+          break;
+        case DataPointCollection::UInt16Labels:
+          CountLabels((const unsigned short*)data.labels, indices, count, bins);
+          break;
+        default:
+          CountLabels((const unsigned int*)data.labels, indices, count, bins);
+          break;
+      }
+
+      sampleCount_ += count;
+    }
+
+    void Aggregate(const HistogramAggregator& aggregator)
+    {
+      assert(aggregator.BinCount() == BinCount());
+
+      sampleCount_ += aggregator.sampleCount_;
+
+      if (IsSparse())
+      {
+        MergeSparse(aggregator.sparseBins_);
+        return;
+      }
+
+      if (IsInline())
+      {
+        for (unsigned int b = 0; b < InlineBinCapacity; b++)
+          inlineBins_[b] += aggregator.inlineBins_[b];
+        return;
+      }
+
+      for (unsigned int b = 0; b < BinCount(); b++)
+        bins_[b] += aggregator.bins_[b];
+    }
+
+    HistogramAggregator DeepClone() const
+    {
+      return *this;
+    }
+
+  private:
+    template<typename Label>
+    static void CountLabels(const Label* labels, const unsigned int* indices, unsigned int count, unsigned int* bins)
+    {
+      for (unsigned int k = 0; k < count; k++)
+        bins[labels[indices[k]]]++;
+    }
+
+    // In place merge of two sorted sparse histograms, filling from the back
+    // so that no temporary is needed once capacity has been reached.
+    void MergeSparse(const std::vector<SparseBin>& other)
+    {
+      unsigned int added = 0;
+      unsigned int i = 0, j = 0;
+      while (j < other.size())
+      {
+        if (i < sparseBins_.size() && sparseBins_[i].first < other[j].first)
+          i++;
+        else if (i < sparseBins_.size() && sparseBins_[i].first == other[j].first)
+          i++, j++;
+        else
+          added++, j++;
+      }
+
+      int dst = (int)(sparseBins_.size() + added) - 1;
+      int a = (int)sparseBins_.size() - 1;
+      int b = (int)other.size() - 1;
+      sparseBins_.resize(sparseBins_.size() + added);
+
+      while (b >= 0)
+      {
+        if (a >= 0 && sparseBins_[a].first > other[b].first)
+        {
+          sparseBins_[dst--] = sparseBins_[a--];
+        }
+        else if (a >= 0 && sparseBins_[a].first == other[b].first)
+        {
+          sparseBins_[dst] = sparseBins_[a--];
+          sparseBins_[dst--].second += other[b--].second;
+        }
+        else
+        {
+          sparseBins_[dst--] = other[b--];
+        }
+      }
+    }
+  };
+
+  // Running count, sum and sum of squares of the target values. All
+  // operations are O(1), so merging partition statistics while sweeping
+  // the candidate thresholds costs the same for any number of samples.
+  struct GaussianAggregator1d
+  {
+  public:
+    unsigned int sampleCount_;
+    double sx_;
+    double sxx_;
+
+  public:
+    GaussianAggregator1d()
+    {
+      Clear();
+    }
+
+    unsigned int SampleCount() const {
+      return sampleCount_;
+    }
+
+    double Mean() const
+    {
+      return sampleCount_ == 0 ? 0.0 : sx_ / sampleCount_;
+    }
+
+    double Variance() const
+    {
+      if (sampleCount_ == 0)
+        return 0.0;
+
+      double mean = sx_ / sampleCount_;
+      double variance = sxx_ / sampleCount_ - mean * mean;
+
+      // Cancellation can make the difference slightly negative.
+      return variance < 0.0 ? 0.0 : variance;
+    }
+
+    // IStatisticsAggregator implementation
+    void Clear()
+    {
+      sampleCount_ = 0;
+      sx_ = 0.0;
+      sxx_ = 0.0;
+    }
+
+    void Aggregate(const IDataPointCollection& data, unsigned int index)
+    {
+      const DataPointCollection& concreteData = (const DataPointCollection&)(data);
+
+      double y = concreteData.GetTarget(index);
+      sampleCount_ += 1;
+      sx_ += y;
+      sxx_ += y * y;
+    }
+
+    // Aggregates the data points indices[0], ..., indices[count-1].
+    void Aggregate(const DataPointCollection& data, const unsigned int* indices, unsigned int count)
+    {
+      for (unsigned int k = 0; k < count; k++)
+      {
+        double y = data.GetTarget(indices[k]);
+        sx_ += y;
+        sxx_ += y * y;
+      }
+
+      sampleCount_ += count;
+    }
+
+    void Aggregate(const GaussianAggregator1d& aggregator)
+    {
+      sampleCount_ += aggregator.sampleCount_;
+      sx_ += aggregator.sx_;
+      sxx_ += aggregator.sxx_;
+    }
+
+    GaussianAggregator1d DeepClone() const
+    {
+      return *this;
+    }
+  };
+} } }
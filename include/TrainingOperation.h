@@ -0,0 +1,609 @@
+// Depth first tree training as in Sherwood's TreeTrainer.h, with counters
+// and timers for the phases of training.
+#pragma once
+
+#include "sherwood_core.h"
+#include <vector>
+#include <algorithm>
+#include <cassert>
+
+#if defined(_WIN32)
+  #ifndef NOMINMAX
+    #define NOMINMAX
+  #endif
+  #include <windows.h>
+#else
+  #include <time.h>
+  #include <sys/resource.h>
+#endif
+
+namespace MicrosoftResearch { namespace Cambridge { namespace Sherwood
+{
+
+// Wall clock time in seconds.
+double WallTime()
+{
+#if defined(_WIN32)
+  LARGE_INTEGER frequency, counter;
+  QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&counter);
+  return (double)counter.QuadPart / (double)frequency.QuadPart;
+#else
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + 1e-9 * t.tv_nsec;
+#endif
+}
+
+// Sleeps for about the given number of seconds.
+void SleepSeconds(double seconds)
+{
+#if defined(_WIN32)
+  Sleep((DWORD)(1000 * seconds));
+#else
+  timespec t;
+  t.tv_sec = (time_t)seconds;
+  t.tv_nsec = (long)(1e9 * (seconds - t.tv_sec));
+  nanosleep(&t, 0);
+#endif
+}
+
+// Peak resident memory of the process in bytes (0 if unknown). Within
+// MATLAB this includes MATLAB itself.
+double PeakMemoryBytes()
+{
+#if defined(_WIN32)
+  return 0;
+#else
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  #if defined(__APPLE__)
+    return (double)usage.ru_maxrss;
+  #else
+    return 1024.0 * usage.ru_maxrss;
+  #endif
+#endif
+}
+
+// Seed for item b (a tree or node) of a stream seeded with a, with the
+// bits mixed so that neighbouring items get unrelated seeds.
+unsigned int MixSeed(unsigned int a, unsigned int b)
+{
+  unsigned int h = a * 0x9E3779B1u + b;
+  h ^= h >> 16;
+  h *= 0x85EBCA6Bu;
+  h ^= h >> 13;
+  h *= 0xC2B2AE35u;
+  h ^= h >> 16;
+  return h;
+}
+
+// Draws count distinct numbers of 0, ..., n-1 into sample with Floyd's
+// algorithm, in O(count) time. drawn has n elements, all zero, and is
+// left so.
+void SampleWithoutReplacement(Random& random, unsigned int n, unsigned int count,
+                              std::vector<unsigned int>& sample, std::vector<char>& drawn)
+{
+  sample.clear();
+
+  for (unsigned int j = n - count; j < n; j++)
+  {
+    unsigned int t = (unsigned int)random.Next(0, (int)j + 1);
+    if (drawn[t]) {
+      t = j;
+    }
+
+    drawn[t] = 1;
+    sample.push_back(t);
+  }
+
+  for (unsigned int k = 0; k < sample.size(); k++) {
+    drawn[sample[k]] = 0;
+  }
+}
+
+// Counters and timers of training. The level vectors are indexed by
+// depth and summed over trees; times of a node exclude its children.
+struct TrainingStatistics
+{
+  unsigned int NumberOfTrees;
+  unsigned int TreesTrained;
+
+  // Wall time of each tree, in the order the trees were finished.
+  std::vector<double> TreeSeconds;
+
+  std::vector<double> LevelSeconds;
+  std::vector<double> LevelNodes;
+  std::vector<double> LevelSplits;
+
+  double NodesSplit;
+  double Leaves;
+  double CandidateFeatures;
+  // Number of (feature, threshold) pairs for which the gain was computed.
+  double GainEvaluations;
+  double ResponseEvaluations;
+
+  // Responses of the candidate features.
+  double ResponseSeconds;
+  // Choosing thresholds, aggregating statistics and computing the gain.
+  double GainSeconds;
+  // Child statistics and reordering the data for the chosen split.
+  double PartitionSeconds;
+
+  // Gain importance of each dimension: the information gain of each split
+  // node times its number of training samples, summed over the split
+  // nodes using the dimension (see AddFeatureUsage).
+  std::vector<double> GainImportance;
+
+  // With Bootstrap: the misclassification rate (classification) or mean
+  // squared error (regression) of the examples left out of at least one
+  // tree, predicted by the trees they were left out of. ConfusionMatrix
+  // is ordered as (true class, predicted class) with NumberOfClasses rows.
+  double OutOfBagError;
+  unsigned int OutOfBagExamples;
+  unsigned int NumberOfClasses;
+  std::vector<double> ConfusionMatrix;
+
+  // Since training started.
+  double TotalSeconds;
+  double PeakMemoryBytes;
+
+  TrainingStatistics()
+  {
+    NumberOfTrees = 0;
+    TreesTrained = 0;
+    NodesSplit = 0;
+    Leaves = 0;
+    CandidateFeatures = 0;
+    GainEvaluations = 0;
+    ResponseEvaluations = 0;
+    ResponseSeconds = 0;
+    GainSeconds = 0;
+    PartitionSeconds = 0;
+    OutOfBagError = 0;
+    OutOfBagExamples = 0;
+    NumberOfClasses = 0;
+    TotalSeconds = 0;
+    PeakMemoryBytes = 0;
+  }
+
+  // Estimate from the mean time per tree so far.
+  double SecondsRemaining() const
+  {
+    if (TreesTrained == 0)
+      return 0;
+
+    return TotalSeconds / TreesTrained * (NumberOfTrees - TreesTrained);
+  }
+
+  void AddNode(int depth, bool split, double seconds)
+  {
+    if (LevelSeconds.size() <= (size_t)depth) {
+      LevelSeconds.resize(depth + 1, 0.0);
+      LevelNodes.resize(depth + 1, 0.0);
+      LevelSplits.resize(depth + 1, 0.0);
+    }
+
+    LevelSeconds[depth] += seconds;
+    LevelNodes[depth] += 1;
+
+    if (split) {
+      LevelSplits[depth] += 1;
+      NodesSplit += 1;
+    } else {
+      Leaves += 1;
+    }
+  }
+
+  // Adds the statistics of a tree.
+  void Merge(const TrainingStatistics& tree)
+  {
+    TreesTrained += tree.TreesTrained;
+    TreeSeconds.insert(TreeSeconds.end(), tree.TreeSeconds.begin(), tree.TreeSeconds.end());
+
+    for (size_t d = 0; d < tree.LevelSeconds.size(); d++) {
+      if (LevelSeconds.size() <= d) {
+        LevelSeconds.resize(d + 1, 0.0);
+        LevelNodes.resize(d + 1, 0.0);
+        LevelSplits.resize(d + 1, 0.0);
+      }
+
+      LevelSeconds[d] += tree.LevelSeconds[d];
+      LevelNodes[d] += tree.LevelNodes[d];
+      LevelSplits[d] += tree.LevelSplits[d];
+    }
+
+    if (GainImportance.size() < tree.GainImportance.size()) {
+      GainImportance.resize(tree.GainImportance.size(), 0.0);
+    }
+
+    for (size_t d = 0; d < tree.GainImportance.size(); d++) {
+      GainImportance[d] += tree.GainImportance[d];
+    }
+
+    NodesSplit += tree.NodesSplit;
+    Leaves += tree.Leaves;
+    CandidateFeatures += tree.CandidateFeatures;
+    GainEvaluations += tree.GainEvaluations;
+    ResponseEvaluations += tree.ResponseEvaluations;
+    ResponseSeconds += tree.ResponseSeconds;
+    GainSeconds += tree.GainSeconds;
+    PartitionSeconds += tree.PartitionSeconds;
+  }
+};
+
+// Receives the statistics as trees are finished.
+class ITrainingProgress
+{
+public:
+  virtual ~ITrainingProgress() {}
+
+  // Called on the thread that started training, after one or more trees
+  // have been finished.
+  virtual void TreesTrained(const TrainingStatistics& statistics) = 0;
+};
+
+// Prints one line per report.
+class PrintTrainingProgress : public ITrainingProgress
+{
+public:
+  void TreesTrained(const TrainingStatistics& statistics)
+  {
+    SHERWOOD_PRINTF("Trained %d of %d trees in %.1f s, about %.1f s remaining.\n",
+      statistics.TreesTrained, statistics.NumberOfTrees,
+      statistics.TotalSeconds, statistics.SecondsRemaining());
+  }
+};
+
+void PrintTrainingStatistics(const TrainingStatistics& statistics)
+{
+  SHERWOOD_PRINTF("Trained %d trees in %.2f s (peak memory %.0f MB).\n",
+    statistics.TreesTrained, statistics.TotalSeconds, statistics.PeakMemoryBytes / (1024.0 * 1024.0));
+  SHERWOOD_PRINTF("Split nodes: %.0f, leaves: %.0f, candidate features: %.0f, gain evaluations: %.0f, responses: %.0f.\n",
+    statistics.NodesSplit, statistics.Leaves, statistics.CandidateFeatures,
+    statistics.GainEvaluations, statistics.ResponseEvaluations);
+  SHERWOOD_PRINTF("Time (summed over threads) in responses: %.2f s, gain: %.2f s, partitioning: %.2f s.\n",
+    statistics.ResponseSeconds, statistics.GainSeconds, statistics.PartitionSeconds);
+
+  if (statistics.OutOfBagExamples > 0) {
+    SHERWOOD_PRINTF("Out-of-bag error: %g (%d examples).\n", statistics.OutOfBagError, statistics.OutOfBagExamples);
+  }
+
+  for (size_t d = 0; d < statistics.LevelSeconds.size(); d++) {
+    SHERWOOD_PRINTF("Level %d: %.0f nodes, %.0f split, %.3f s.\n",
+      (int)d, statistics.LevelNodes[d], statistics.LevelSplits[d], statistics.LevelSeconds[d]);
+  }
+}
+
+// F: Feature Response
+// S: StatisticsAggregator
+//
+// Each node draws its random numbers from a Random seeded by the tree seed
+// and the node index, so a node is trained the same regardless of the
+// rest of the tree. A tree trained with fewer MaxDecisionLevels is then
+// the same as a deeper tree truncated (see TruncateTree).
+template<typename F, typename S>
+class TrainingOperation
+{
+  unsigned int treeSeed_;
+  Random* random_;
+  FeatureTrainingContext<F,S>& context_;
+  const TrainingParameters& parameters_;
+  const DataPointCollection& data_;
+  TrainingStatistics& statistics_;
+
+  std::vector<unsigned int> indices_;
+
+  // Responses of the current candidate feature and of the best one so
+  // far, swapped when a candidate becomes the best so that the partition
+  // does not evaluate the winning feature again.
+  std::vector<float> responses_;
+  std::vector<float> bestResponses_;
+
+  S parentStatistics_, leftChildStatistics_, rightChildStatistics_;
+  std::vector<S> partitionStatistics_;
+
+  std::vector<float> quantiles_;
+  std::vector<float> thresholds_;
+
+  // The candidate feature and the best one, reused for all nodes.
+  F feature_, bestFeature_;
+
+  // Dimensions the features of the tree read, empty for all dimensions.
+  std::vector<unsigned int> treeAxes_;
+
+  // Distinct dimensions of the candidate features of a node, for features
+  // reading one dimension.
+  std::vector<unsigned int> candidateAxes_;
+  std::vector<char> drawn_;
+
+public:
+  // Trains on the data points in indices, or all data points if null,
+  // with features reading a random subset of featuresPerTree dimensions
+  // (0 for all dimensions). Only features reading one dimension can be
+  // restricted to a subset.
+  TrainingOperation(Random& random,
+                    FeatureTrainingContext<F,S>& context,
+                    const TrainingParameters& parameters,
+                    const IDataPointCollection& data,
+                    TrainingStatistics& statistics,
+                    const std::vector<unsigned int>* indices = 0,
+                    unsigned int featuresPerTree = 0)
+  : treeSeed_((unsigned int)random.Next()), random_(0),
+    context_(context), parameters_(parameters), data_((const DataPointCollection&)data), statistics_(statistics)
+  {
+    if (indices) {
+      indices_ = *indices;
+    } else {
+      indices_.resize(data.Count());
+      for (unsigned int i = 0; i < data.Count(); i++)
+        indices_[i] = i;
+    }
+
+    responses_.resize(indices_.size());
+    bestResponses_.resize(indices_.size());
+
+    parentStatistics_ = context_.GetStatisticsAggregator();
+    leftChildStatistics_ = context_.GetStatisticsAggregator();
+    rightChildStatistics_ = context_.GetStatisticsAggregator();
+
+    partitionStatistics_.resize(parameters.NumberOfCandidateThresholdsPerFeature + 1);
+    for (unsigned int b = 0; b < parameters.NumberOfCandidateThresholdsPerFeature + 1; b++)
+      partitionStatistics_[b] = context_.GetStatisticsAggregator();
+
+    unsigned int dimensions = data_.Dimensions();
+    drawn_.resize(dimensions, 0);
+
+    // Options rejects FeaturesPerTree for other features, before training.
+    assert(featuresPerTree == 0 || F::FeatureMajor());
+
+    // The subset is drawn from an item of the tree's stream that no node
+    // uses, so the nodes draw the same numbers with or without it.
+    if (featuresPerTree > 0 && featuresPerTree < dimensions)
+    {
+      Random subsetRandom(MixSeed(treeSeed_, 0xFFFFFFFFu));
+      SampleWithoutReplacement(subsetRandom, dimensions, featuresPerTree, treeAxes_, drawn_);
+      std::sort(treeAxes_.begin(), treeAxes_.end());
+    }
+  }
+
+  unsigned int Count() const
+  {
+    return (unsigned int)indices_.size();
+  }
+
+  void TrainNodesRecurse(Tree<F,S>& tree, int nodeIndex, unsigned int i0, unsigned int i1, int recurseDepth)
+  {
+    double nodeStart = WallTime();
+
+    Random random(MixSeed(treeSeed_, nodeIndex));
+    random_ = &random;
+
+    parentStatistics_.Clear();
+    parentStatistics_.Aggregate(data_, &indices_[i0], i1 - i0);
+
+    if (recurseDepth >= parameters_.MaxDecisionLevels)
+    {
+      tree.GetNode(nodeIndex).InitializeLeaf(parentStatistics_.DeepClone());
+      statistics_.AddNode(recurseDepth, false, WallTime() - nodeStart);
+      return;
+    }
+
+    double maxGain = 0.0;
+    float bestThreshold = 0.0f;
+
+    // Features reading one dimension are drawn on distinct dimensions, so
+    // that no candidate is evaluated twice.
+    unsigned int candidates = (unsigned int)parameters_.NumberOfCandidateFeatures;
+
+    if (F::FeatureMajor())
+    {
+      unsigned int axes = treeAxes_.empty() ? data_.Dimensions() : (unsigned int)treeAxes_.size();
+      candidates = std::min(candidates, axes);
+
+      SampleWithoutReplacement(*random_, axes, candidates, candidateAxes_, drawn_);
+
+      for (unsigned int k = 0; k < candidates && !treeAxes_.empty(); k++) {
+        candidateAxes_[k] = treeAxes_[candidateAxes_[k]];
+      }
+    }
+
+    for (unsigned int f = 0; f < candidates; f++)
+    {
+      double start = WallTime();
+
+      if (F::FeatureMajor()) {
+        SetFeatureAxis(feature_, candidateAxes_[f]);
+      } else {
+        context_.GetRandomFeature(*random_, feature_);
+      }
+
+      feature_.GetResponses(data_, &indices_[i0], i1 - i0, &responses_[i0]);
+
+      double responsesDone = WallTime();
+      statistics_.ResponseSeconds += responsesDone - start;
+      statistics_.ResponseEvaluations += i1 - i0;
+      statistics_.CandidateFeatures += 1;
+
+      unsigned int nThresholds = ChooseCandidateThresholds(i0, i1);
+
+      if (nThresholds == 0)
+      {
+        statistics_.GainSeconds += WallTime() - responsesDone;
+        continue;
+      }
+
+      for (unsigned int b = 0; b < nThresholds + 1; b++)
+        partitionStatistics_[b].Clear();
+
+      for (unsigned int i = i0; i < i1; i++)
+      {
+        unsigned int b = (unsigned int)(std::upper_bound(thresholds_.begin(), thresholds_.begin() + nThresholds, responses_[i]) - thresholds_.begin());
+        partitionStatistics_[b].Aggregate(data_, indices_[i]);
+      }
+
+      bool best = false;
+
+      for (unsigned int t = 0; t < nThresholds; t++)
+      {
+        leftChildStatistics_.Clear();
+        rightChildStatistics_.Clear();
+
+        for (unsigned int p = 0; p < nThresholds + 1; p++)
+        {
+          if (p <= t)
+            leftChildStatistics_.Aggregate(partitionStatistics_[p]);
+          else
+            rightChildStatistics_.Aggregate(partitionStatistics_[p]);
+        }
+
+        double gain = context_.ComputeInformationGain(parentStatistics_, leftChildStatistics_, rightChildStatistics_);
+
+        if (gain >= maxGain)
+        {
+          maxGain = gain;
+          bestThreshold = thresholds_[t];
+          best = true;
+        }
+      }
+
+      if (best)
+      {
+        bestFeature_ = feature_;
+        responses_.swap(bestResponses_);
+      }
+
+      statistics_.GainEvaluations += nThresholds;
+      statistics_.GainSeconds += WallTime() - responsesDone;
+    }
+
+    if (maxGain == 0.0)
+    {
+      tree.GetNode(nodeIndex).InitializeLeaf(parentStatistics_.DeepClone());
+      statistics_.AddNode(recurseDepth, false, WallTime() - nodeStart);
+      return;
+    }
+
+    double partitionStart = WallTime();
+
+    // Reorder the data point indices using the winning feature and
+    // threshold, and compute the child statistics so that the context can
+    // decide whether to terminate training of this branch.
+    leftChildStatistics_.Clear();
+    rightChildStatistics_.Clear();
+
+    for (unsigned int i = i0; i < i1; i++)
+    {
+      if (bestResponses_[i] < bestThreshold)
+        leftChildStatistics_.Aggregate(data_, indices_[i]);
+      else
+        rightChildStatistics_.Aggregate(data_, indices_[i]);
+    }
+
+    if (context_.ShouldTerminate(parentStatistics_, leftChildStatistics_, rightChildStatistics_, maxGain))
+    {
+      tree.GetNode(nodeIndex).InitializeLeaf(parentStatistics_.DeepClone());
+      statistics_.PartitionSeconds += WallTime() - partitionStart;
+      statistics_.AddNode(recurseDepth, false, WallTime() - nodeStart);
+      return;
+    }
+
+    tree.GetNode(nodeIndex).InitializeSplit(bestFeature_, bestThreshold, parentStatistics_.DeepClone());
+    AddFeatureUsage(bestFeature_, maxGain * (i1 - i0), statistics_.GainImportance);
+
+    unsigned int ii = Partition(i0, i1, bestThreshold);
+
+    statistics_.PartitionSeconds += WallTime() - partitionStart;
+    statistics_.AddNode(recurseDepth, true, WallTime() - nodeStart);
+
+    TrainNodesRecurse(tree, nodeIndex * 2 + 1, i0, ii, recurseDepth + 1);
+    TrainNodesRecurse(tree, nodeIndex * 2 + 2, ii, i1, recurseDepth + 1);
+  }
+
+private:
+  // Thresholds uniformly between sorted samples of the responses in
+  // [i0, i1). Returns the number of thresholds, 0 if the responses are
+  // all equal.
+  unsigned int ChooseCandidateThresholds(unsigned int i0, unsigned int i1)
+  {
+    unsigned int nThresholds;
+
+    if (i1 - i0 > parameters_.NumberOfCandidateThresholdsPerFeature)
+    {
+      nThresholds = parameters_.NumberOfCandidateThresholdsPerFeature;
+      quantiles_.resize(nThresholds + 1);
+
+      for (unsigned int i = 0; i < nThresholds + 1; i++)
+        quantiles_[i] = responses_[random_->Next(i0, i1)];
+    }
+    else
+    {
+      nThresholds = i1 - i0 - 1;
+      quantiles_.assign(responses_.begin() + i0, responses_.begin() + i1);
+    }
+
+    std::sort(quantiles_.begin(), quantiles_.end());
+
+    if (quantiles_[0] == quantiles_[nThresholds])
+      return 0;
+
+    thresholds_.resize(nThresholds);
+    for (unsigned int i = 0; i < nThresholds; i++)
+      thresholds_[i] = quantiles_[i] + (float)(random_->NextDouble() * (quantiles_[i + 1] - quantiles_[i]));
+
+    return nThresholds;
+  }
+
+  // Moves the data points with best response < threshold first, returns
+  // the index of the first data point with best response >= threshold.
+  unsigned int Partition(unsigned int i0, unsigned int i1, float threshold)
+  {
+    int i = (int)i0;
+    int j = (int)i1 - 1;
+
+    while (i != j)
+    {
+      if (bestResponses_[i] >= threshold)
+      {
+        std::swap(bestResponses_[i], bestResponses_[j]);
+        std::swap(indices_[i], indices_[j]);
+        j--;
+      }
+      else
+      {
+        i++;
+      }
+    }
+
+    return bestResponses_[i] >= threshold ? i : i + 1;
+  }
+};
+
+// Trains on the data points in indices (which may repeat), or all data
+// points if null, with axis-aligned features reading featuresPerTree
+// dimensions (0 for all). One number is drawn from random, the seed of the tree.
+template<typename F, typename S>
+std::auto_ptr<Tree<F,S> > TrainTree(Random& random,
+                                    FeatureTrainingContext<F,S>& context,
+                                    const TrainingParameters& parameters,
+                                    const IDataPointCollection& data,
+                                    TrainingStatistics& statistics,
+                                    const std::vector<unsigned int>* indices = 0,
+                                    unsigned int featuresPerTree = 0)
+{
+  double start = WallTime();
+
+  std::auto_ptr<Tree<F,S> > tree(new Tree<F,S>(parameters.MaxDecisionLevels));
+
+  TrainingOperation<F,S> trainingOperation(random, context, parameters, data, statistics, indices, featuresPerTree);
+  trainingOperation.TrainNodesRecurse(*tree, 0, 0, trainingOperation.Count(), 0);
+
+  tree->CheckValid();
+
+  statistics.TreesTrained += 1;
+  statistics.TreeSeconds.push_back(WallTime() - start);
+
+  return tree;
+}
+
+}}}
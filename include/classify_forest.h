@@ -0,0 +1,518 @@
+// Forest evaluation on a DataPointCollection, shared by the MEX file
+// and the command line tool.
+#pragma once
+
+#include "sherwood_core.h"
+#include "packed_forest.h"
+#include <vector>
+#include <algorithm>
+#include <limits>
+
+namespace MicrosoftResearch { namespace Cambridge { namespace Sherwood
+{
+
+// Samples are classified in blocks, so that the temporaries of Tree::Apply
+// and the output columns being accumulated stay in cache until the block
+// is normalized.
+const unsigned int ClassifyBlockSize = 4096;
+
+// Tree and statistics types of Forest and PackedForest, which are both
+// evaluated by ClassifyForest and RegressForest.
+template<typename ForestType> struct ForestTypes;
+
+template<typename F, typename S>
+struct ForestTypes<Forest<F,S> >
+{
+  typedef Tree<F,S> TreeType;
+  typedef S StatisticsType;
+};
+
+template<typename F, typename S>
+struct ForestTypes<PackedForest<F,S> >
+{
+  typedef const typename PackedForest<F,S>::TreeType TreeType;
+  typedef typename PackedForest<F,S>::StatisticsType StatisticsType;
+};
+
+// Index of the leaf node reached by data point i.
+template<typename TreeType>
+int ApplyDataPoint(const TreeType& tree, const IDataPointCollection& data, unsigned int i)
+{
+  int nodeIndex = 0;
+
+  while (!tree.GetNode(nodeIndex).IsLeaf())
+  {
+    nodeIndex = tree.GetNode(nodeIndex).Feature.GetResponse(data, i) < tree.GetNode(nodeIndex).Threshold ?
+      2*nodeIndex + 1 : 2*nodeIndex + 2;
+  }
+
+  return nodeIndex;
+}
+
+// Difference between the largest and second largest element, and the
+// share of the largest element.
+template<typename T>
+void TopTwoMargin(const T* column, unsigned int n, double& margin, double& share)
+{
+  double first = 0, second = 0, sum = 0;
+
+  for (unsigned int c = 0; c < n; c++)
+  {
+    double value = column[c];
+    sum += value;
+
+    if (value > first) {
+      second = first;
+      first = value;
+    } else if (value > second) {
+      second = value;
+    }
+  }
+
+  margin = first - second;
+  share = sum > 0 ? first / sum : 0;
+}
+
+template<typename F>
+unsigned int CountClasses(Forest<F, HistogramAggregator>& forest)
+{
+  return forest.GetTree(0).GetNode(0).TrainingDataStatistics.BinCount();
+}
+
+template<typename F>
+unsigned int CountClasses(PackedForest<F, HistogramAggregator>& forest)
+{
+  return forest.GetTree(0).GetNode(0).TrainingDataStatistics.BinCount();
+}
+
+// Outputs of ClassifyForest, all zero initialized by the caller. Only
+// probabilities is required, the others are computed when not null.
+struct ClassificationOutputs
+{
+  // Normalized class probabilities ordered as (class, index)
+  float* probabilities;
+  // Summed histograms (TreeAggregator histogram) ordered as (class, index)
+  unsigned int* counts;
+  // Summed probabilities (TreeAggregator probability) ordered as (class, index)
+  float* probabilitySums;
+  // Zero based leaf node index ordered as (tree, index)
+  unsigned int* leaves;
+  // Tree probabilities ordered as (class, tree, index)
+  float* treeProbabilities;
+  // Number of trees evaluated for each index
+  unsigned int* treesEvaluated;
+
+  ClassificationOutputs()
+  : probabilities(0), counts(0), probabilitySums(0), leaves(0), treeProbabilities(0), treesEvaluated(0)
+  {}
+};
+
+// ForestType: Forest or PackedForest
+//
+// With EarlyExit trees are evaluated in order for each example until the
+// margin between the two most probable classes exceeds what the remaining
+// trees can add, so the most probable class is the same as with all trees,
+// or until the share of the most probable class exceeds EarlyExitConfidence
+// (never with the default of 1).
+// Leaves and tree probabilities are left as zero for trees not evaluated.
+template<typename ForestType>
+void ClassifyForest(ForestType& forest, const DataPointCollection& testData, const Options& options, ClassificationOutputs& out)
+{
+  typedef typename ForestTypes<ForestType>::TreeType TreeType;
+  typedef typename ForestTypes<ForestType>::StatisticsType S;
+
+  unsigned int num_classes = CountClasses(forest);
+  unsigned int num_trees = forest.TreeCount();
+  unsigned int num_points = testData.Count();
+
+  bool histogram = options.TreeAggregator == Histogram;
+
+  // Counts are summed as integers when they are returned, otherwise
+  // directly in the output.
+  bool sum_counts = out.counts != 0;
+  float* output = out.probabilities;
+
+  // Perform classification
+  // forest::apply is wasting memory, bypassing it.
+  //
+  // Note: leafNodeIndices should unsigned int, modify tree.h and the line below.
+  //
+  std::vector<int> leafNodeIndices;
+
+  // Largest contribution a tree can make to a single class, summed over
+  // trees t, ..., num_trees-1.
+  std::vector<double> remaining(num_trees + 1, 0.0);
+
+  if (options.EarlyExit)
+  {
+    for (int t = (int)num_trees - 1; t >= 0; t--)
+    {
+      TreeType& tree = forest.GetTree(t);
+      double largest = 0;
+
+      for (int n = 0; n < tree.NodeCount(); n++)
+      {
+        if (!tree.GetNode(n).IsLeaf())
+          continue;
+
+        const S& aggregator = tree.GetNode(n).TrainingDataStatistics;
+        unsigned int c = aggregator.FindTallestBinIndex();
+        double contribution = histogram ? (double)aggregator.GetCount(c) : (double)aggregator.GetProbability(c);
+        largest = std::max(largest, contribution);
+      }
+
+      remaining[t] = remaining[t + 1] + largest;
+    }
+  }
+
+  // Examples in the block still being evaluated.
+  std::vector<unsigned int> active;
+
+  // Features of a block converted to float (unless already single).
+  std::vector<float> blockFeatures;
+
+  for (unsigned int first = 0; first < num_points; first += ClassifyBlockSize)
+  {
+    unsigned int count = std::min(ClassifyBlockSize, num_points - first);
+    DataPointCollection blockData(testData, first, count, blockFeatures);
+
+    if (options.EarlyExit)
+    {
+      active.clear();
+      for (unsigned int j = 0; j < count; j++) {
+        active.push_back(j);
+      }
+
+      for (unsigned int t = 0; t < num_trees && !active.empty(); t++)
+      {
+        TreeType& tree = forest.GetTree(t);
+
+        for (unsigned int a = 0; a < active.size(); )
+        {
+          unsigned int j = active[a];
+          unsigned int i = first + j;
+          int leafNodeIndex = ApplyDataPoint(tree, blockData, j);
+          const S& aggregator = tree.GetNode(leafNodeIndex).TrainingDataStatistics;
+
+          double margin, share;
+          if (sum_counts) {
+            aggregator.AccumulateCounts(&out.counts[(size_t)i*num_classes]);
+            TopTwoMargin(&out.counts[(size_t)i*num_classes], num_classes, margin, share);
+          } else {
+            if (histogram) {
+              aggregator.AccumulateCounts(&output[(size_t)i*num_classes]);
+            } else {
+              aggregator.AccumulateProbabilities(&output[(size_t)i*num_classes]);
+            }
+            TopTwoMargin(&output[(size_t)i*num_classes], num_classes, margin, share);
+          }
+
+          if (out.leaves) {
+            out.leaves[(size_t)i*num_trees + t] = leafNodeIndex;
+          }
+
+          if (out.treeProbabilities) {
+            aggregator.AccumulateProbabilities(&out.treeProbabilities[((size_t)i*num_trees + t)*num_classes]);
+          }
+
+          bool done = margin > remaining[t + 1] ||
+            ((int)t + 1 >= options.EarlyExitMinTrees && share > options.EarlyExitConfidence);
+
+          if (done || t + 1 == num_trees) {
+            if (out.treesEvaluated) {
+              out.treesEvaluated[i] = t + 1;
+            }
+
+            active[a] = active.back();
+            active.pop_back();
+          } else {
+            a++;
+          }
+        }
+      }
+    }
+    else
+    {
+      // Forest.h (Apply)
+      for (unsigned int t = 0; t < num_trees; t++)
+      {
+        TreeType& tree = forest.GetTree(t);
+
+        // Tree.h
+        tree.Apply(blockData, leafNodeIndices);
+
+        for (unsigned int j = 0; j < count; j++)
+        {
+          unsigned int i = first + j;
+          const S& aggregator = tree.GetNode(leafNodeIndices[j]).TrainingDataStatistics;
+
+          if (sum_counts) {
+            aggregator.AccumulateCounts(&out.counts[(size_t)i*num_classes]);
+          } else if (histogram) {
+            aggregator.AccumulateCounts(&output[(size_t)i*num_classes]);
+          } else {
+            aggregator.AccumulateProbabilities(&output[(size_t)i*num_classes]);
+          }
+        }
+
+        if (out.leaves) {
+          for (unsigned int j = 0; j < count; j++) {
+            out.leaves[((size_t)first + j)*num_trees + t] = leafNodeIndices[j];
+          }
+        }
+
+        if (out.treeProbabilities) {
+          for (unsigned int j = 0; j < count; j++)
+          {
+            const S& aggregator = tree.GetNode(leafNodeIndices[j]).TrainingDataStatistics;
+            aggregator.AccumulateProbabilities(&out.treeProbabilities[(((size_t)first + j)*num_trees + t)*num_classes]);
+          }
+        }
+
+        leafNodeIndices.clear();
+      }
+
+      if (out.treesEvaluated) {
+        for (unsigned int j = 0; j < count; j++) {
+          out.treesEvaluated[first + j] = num_trees;
+        }
+      }
+    }
+
+    // Normalize the block in place.
+    for (unsigned int i = first; i < first + count; i++)
+    {
+      float* P = &output[(size_t)i*num_classes];
+
+      if (sum_counts) {
+        for (unsigned int c = 0; c < num_classes; c++) {
+          P[c] = (float)out.counts[(size_t)i*num_classes + c];
+        }
+      } else if (out.probabilitySums) {
+        std::copy(P, P + num_classes, &out.probabilitySums[(size_t)i*num_classes]);
+      }
+
+      float denom = 0;
+      for (unsigned int c = 0; c < num_classes; c++) {
+        denom += P[c];
+      }
+
+      for (unsigned int c = 0; c < num_classes; c++) {
+        P[c] /= denom;
+      }
+    }
+  }
+}
+
+// Outputs of RegressForest, all zero initialized by the caller. Only
+// mean is required, the others are computed when not null.
+struct RegressionOutputs
+{
+  // Mean of the tree predictions
+  float* mean;
+  // Predictive variance, the mean of the leaf variances plus the
+  // variance of the tree predictions
+  float* variance;
+  // Zero based leaf node index ordered as (tree, index)
+  unsigned int* leaves;
+  // Tree predictions ordered as (tree, index)
+  float* treePredictions;
+  // Number of trees evaluated for each index, always all trees
+  unsigned int* treesEvaluated;
+
+  RegressionOutputs()
+  : mean(0), variance(0), leaves(0), treePredictions(0), treesEvaluated(0)
+  {}
+};
+
+// ForestType: Forest or PackedForest of GaussianAggregator1d
+template<typename ForestType>
+void RegressForest(ForestType& forest, const DataPointCollection& testData, const Options& options, RegressionOutputs& out)
+{
+  typedef typename ForestTypes<ForestType>::TreeType TreeType;
+  typedef typename ForestTypes<ForestType>::StatisticsType S;
+
+  unsigned int num_trees = forest.TreeCount();
+  unsigned int num_points = testData.Count();
+
+  // Sum and sum of squares of the tree predictions (plus leaf variances) for a block.
+  std::vector<double> sum(ClassifyBlockSize);
+  std::vector<double> sumSquares(ClassifyBlockSize);
+
+  std::vector<int> leafNodeIndices;
+  std::vector<float> blockFeatures;
+
+  for (unsigned int first = 0; first < num_points; first += ClassifyBlockSize)
+  {
+    unsigned int count = std::min(ClassifyBlockSize, num_points - first);
+    DataPointCollection blockData(testData, first, count, blockFeatures);
+
+    std::fill(sum.begin(), sum.end(), 0.0);
+    std::fill(sumSquares.begin(), sumSquares.end(), 0.0);
+
+    for (unsigned int t = 0; t < num_trees; t++)
+    {
+      TreeType& tree = forest.GetTree(t);
+
+      tree.Apply(blockData, leafNodeIndices);
+
+      for (unsigned int j = 0; j < count; j++)
+      {
+        const S& aggregator = tree.GetNode(leafNodeIndices[j]).TrainingDataStatistics;
+        double mean = aggregator.Mean();
+
+        sum[j] += mean;
+        sumSquares[j] += mean * mean + aggregator.Variance();
+      }
+
+      if (out.leaves) {
+        for (unsigned int j = 0; j < count; j++) {
+          out.leaves[((size_t)first + j)*num_trees + t] = leafNodeIndices[j];
+        }
+      }
+
+      if (out.treePredictions) {
+        for (unsigned int j = 0; j < count; j++) {
+          out.treePredictions[((size_t)first + j)*num_trees + t] = (float)tree.GetNode(leafNodeIndices[j]).TrainingDataStatistics.Mean();
+        }
+      }
+
+      leafNodeIndices.clear();
+    }
+
+    for (unsigned int j = 0; j < count; j++)
+    {
+      double mean = sum[j] / num_trees;
+      out.mean[first + j] = (float)mean;
+
+      if (out.variance) {
+        out.variance[first + j] = (float)(sumSquares[j] / num_trees - mean * mean);
+      }
+
+      if (out.treesEvaluated) {
+        out.treesEvaluated[first + j] = num_trees;
+      }
+    }
+  }
+}
+
+// A classification forest of any type, see ClassifyEnsemble.
+class EnsembleMember
+{
+public:
+  virtual ~EnsembleMember() {}
+
+  virtual unsigned int ClassCount() = 0;
+
+  // Class probabilities of data ordered as (class, index), zero
+  // initialized by the caller.
+  virtual void Classify(const DataPointCollection& data, float* probabilities) = 0;
+};
+
+// ForestType: Forest or PackedForest, classified with options.
+template<typename ForestType>
+class ForestEnsembleMember : public EnsembleMember
+{
+public:
+  // Takes ownership of forest.
+  ForestEnsembleMember(ForestType* forest, const Options& options)
+  : forest_(forest), options_(options)
+  {}
+
+  ~ForestEnsembleMember()
+  {
+    delete forest_;
+  }
+
+  unsigned int ClassCount()
+  {
+    return CountClasses(*forest_);
+  }
+
+  void Classify(const DataPointCollection& data, float* probabilities)
+  {
+    ClassificationOutputs out;
+    out.probabilities = probabilities;
+    ClassifyForest(*forest_, data, options_, out);
+  }
+
+private:
+  // Not copyable.
+  ForestEnsembleMember(const ForestEnsembleMember&);
+  ForestEnsembleMember& operator=(const ForestEnsembleMember&);
+
+  ForestType* forest_;
+  Options options_;
+};
+
+// Weighted mean of the class probabilities of the forests, normalized by
+// the sum of the weights, ordered as (class, index). The weights must be
+// finite and nonnegative, with a positive sum. forestProbabilities,
+// if not null, receives the probabilities of each forest ordered as
+// (class, forest, index).
+//
+// The forests are evaluated one block of ClassifyBlockSize examples at a
+// time, so the features of a block are read (and converted) once and stay
+// in cache for all forests.
+void ClassifyEnsemble(const std::vector<EnsembleMember*>& forests, const std::vector<double>& weights,
+                      const DataPointCollection& testData, float* probabilities, float* forestProbabilities = 0)
+{
+  unsigned int num_forests = (unsigned int)forests.size();
+  unsigned int num_points = testData.Count();
+
+  if (num_forests == 0 || weights.size() != num_forests) {
+    throw std::runtime_error("Expected one weight per forest.");
+  }
+
+  unsigned int num_classes = forests[0]->ClassCount();
+  double weightSum = 0;
+
+  for (unsigned int k = 0; k < num_forests; k++)
+  {
+    if (forests[k]->ClassCount() != num_classes) {
+      throw std::runtime_error("The forests have different numbers of classes.");
+    }
+
+    if (!(weights[k] >= 0 && weights[k] <= std::numeric_limits<double>::max())) {
+      throw std::runtime_error("The weights must be finite and nonnegative.");
+    }
+
+    weightSum += weights[k];
+  }
+
+  if (!(weightSum > 0 && weightSum <= std::numeric_limits<double>::max())) {
+    throw std::runtime_error("The sum of the weights must be positive and finite.");
+  }
+
+  std::vector<float> blockFeatures;
+  std::vector<float> blockProbabilities;
+
+  for (unsigned int first = 0; first < num_points; first += ClassifyBlockSize)
+  {
+    unsigned int count = std::min(ClassifyBlockSize, num_points - first);
+    DataPointCollection blockData(testData, first, count, blockFeatures);
+
+    float* P = &probabilities[(size_t)first * num_classes];
+    std::fill(P, P + (size_t)count * num_classes, 0.0f);
+
+    for (unsigned int k = 0; k < num_forests; k++)
+    {
+      blockProbabilities.assign((size_t)count * num_classes, 0.0f);
+      forests[k]->Classify(blockData, &blockProbabilities[0]);
+
+      float weight = (float)(weights[k] / weightSum);
+      for (size_t e = 0; e < (size_t)count * num_classes; e++) {
+        P[e] += weight * blockProbabilities[e];
+      }
+
+      if (forestProbabilities) {
+        for (unsigned int j = 0; j < count; j++) {
+          std::copy(&blockProbabilities[(size_t)j * num_classes], &blockProbabilities[(size_t)(j + 1) * num_classes],
+                    &forestProbabilities[(((size_t)first + j) * num_forests + k) * num_classes]);
+        }
+      }
+    }
+  }
+}
+
+}}}
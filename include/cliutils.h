@@ -0,0 +1,263 @@
+// Parameters and file input/output for the command line tools.
+//
+// Files ending in .csv are text with one example per line and values
+// separated by commas (or white space). Other files are raw little endian
+// binary: float32 features (Dimensions values per example), uint32 labels
+// and float32 targets and outputs.
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+// Key=Value (or --Key=Value) arguments, with the same keys as
+// SherwoodSettings.
+class CliParams
+{
+public:
+
+  CliParams(int argc, char** argv)
+  {
+    for (int i = 0; i < argc; i++) {
+      std::string arg = argv[i];
+
+      if (arg.compare(0, 2, "--") == 0) {
+        arg = arg.substr(2);
+      }
+
+      size_t eq = arg.find('=');
+      if (eq == std::string::npos) {
+        throw std::runtime_error("Expected Key=Value, got " + arg);
+      }
+
+      params[arg.substr(0, eq)] = arg.substr(eq + 1);
+    }
+  }
+
+  template<typename T> T get(const std::string& key, T def)
+  {
+    std::map<std::string, std::string>::const_iterator it = params.find(key);
+    if (it == params.end()) {
+      return def;
+    }
+
+    std::istringstream sin(it->second);
+    T value;
+    if (!(sin >> value)) {
+      throw std::runtime_error("Invalid value for " + key + ": " + it->second);
+    }
+
+    return value;
+  }
+
+private:
+  std::map<std::string, std::string> params;
+};
+
+template<> bool CliParams::get(const std::string& key, bool def)
+{
+  std::map<std::string, std::string>::const_iterator it = params.find(key);
+  if (it == params.end()) {
+    return def;
+  }
+
+  const std::string& value = it->second;
+  if (value == "true" || value == "1") {
+    return true;
+  } else if (value == "false" || value == "0") {
+    return false;
+  }
+
+  throw std::runtime_error("Invalid value for " + key + ": " + value);
+}
+
+template<> std::string CliParams::get(const std::string& key, std::string def)
+{
+  std::map<std::string, std::string>::const_iterator it = params.find(key);
+  return it == params.end() ? def : it->second;
+}
+
+bool is_csv(const std::string& filename)
+{
+  return filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".csv") == 0;
+}
+
+// Reads the values of a file stored example by example, a chunk of
+// examples at a time.
+template<typename T>
+class ExampleReader
+{
+public:
+
+  // dimensions is required for binary files; for .csv files it is the
+  // number of values on the first line, known after the first read.
+  ExampleReader(const std::string& filename, unsigned int dimensions)
+  : filename(filename), csv(is_csv(filename)), numDimensions(dimensions), numExamples(0), remaining(0)
+  {
+    if (!csv && dimensions == 0) {
+      throw std::runtime_error("Dimensions must be given for binary file " + filename);
+    }
+
+    in.open(filename.c_str(), csv ? std::ios_base::in : std::ios_base::in | std::ios_base::binary);
+    if (!in) {
+      throw std::runtime_error("Could not open " + filename);
+    }
+
+    if (!csv) {
+      in.seekg(0, std::ios_base::end);
+      size_t bytes = (size_t)in.tellg();
+      in.seekg(0, std::ios_base::beg);
+
+      if (bytes % (sizeof(T) * dimensions) != 0) {
+        throw std::runtime_error("Size of " + filename + " is not a multiple of the example size");
+      }
+
+      remaining = bytes / (sizeof(T) * dimensions);
+    }
+  }
+
+  unsigned int dimensions() const
+  {
+    return numDimensions;
+  }
+
+  // Replaces values with the next (at most) maxExamples examples. Returns
+  // the number of examples read, 0 at the end of the file.
+  unsigned int read(std::vector<T>& values, unsigned int maxExamples)
+  {
+    values.clear();
+
+    if (!csv) {
+      unsigned int count = (unsigned int)std::min((size_t)maxExamples, remaining);
+
+      values.resize((size_t)count * numDimensions);
+      if (!values.empty()) {
+        std::streamsize bytes = (std::streamsize)(sizeof(T) * values.size());
+        in.read(reinterpret_cast<char*>(&values[0]), bytes);
+
+        if (!in || in.gcount() != bytes) {
+          std::stringstream sout;
+          sout << "Could not read " << filename << " after " << numExamples << " examples";
+          throw std::runtime_error(sout.str());
+        }
+      }
+
+      remaining -= count;
+      numExamples += count;
+      return count;
+    }
+
+    unsigned int count = 0;
+    std::string line;
+    while (count < maxExamples && std::getline(in, line)) {
+      for (size_t i = 0; i < line.size(); i++) {
+        if (line[i] == ',') {
+          line[i] = ' ';
+        }
+      }
+
+      std::istringstream sin(line);
+      size_t before = values.size();
+      T value;
+      while (sin >> value) {
+        values.push_back(value);
+      }
+
+      unsigned int lineCount = (unsigned int)(values.size() - before);
+      if (lineCount == 0) {
+        continue;
+      }
+
+      if (numExamples == 0) {
+        numDimensions = lineCount;
+      } else if (lineCount != numDimensions) {
+        std::stringstream sout;
+        sout << filename << ": line " << numExamples + 1 << " has " << lineCount << " values, expected " << numDimensions;
+        throw std::runtime_error(sout.str());
+      }
+
+      numExamples++;
+      count++;
+    }
+
+    return count;
+  }
+
+private:
+  std::string filename;
+  bool csv;
+  std::ifstream in;
+  unsigned int numDimensions;
+  // Examples read so far, and for binary files the examples left.
+  unsigned int numExamples;
+  size_t remaining;
+};
+
+// Reads all values of a file stored example by example. Returns the number
+// of examples; for .csv files dimensions is the number of values on the
+// first line.
+template<typename T>
+unsigned int read_examples(const std::string& filename, unsigned int& dimensions, std::vector<T>& values)
+{
+  ExampleReader<T> reader(filename, dimensions);
+  unsigned int numExamples = reader.read(values, std::numeric_limits<unsigned int>::max());
+  dimensions = reader.dimensions();
+
+  return numExamples;
+}
+
+// Writes examples of dimensions values each, appending chunks of examples
+// to the file.
+template<typename T>
+class ExampleWriter
+{
+public:
+
+  ExampleWriter(const std::string& filename)
+  : csv(is_csv(filename))
+  {
+    out.open(filename.c_str(), csv ? std::ios_base::out : std::ios_base::out | std::ios_base::binary);
+    if (!out) {
+      throw std::runtime_error("Could not open " + filename);
+    }
+  }
+
+  void write(unsigned int dimensions, unsigned int numExamples, const T* values)
+  {
+    if (csv) {
+      for (unsigned int i = 0; i < numExamples; i++) {
+        for (unsigned int d = 0; d < dimensions; d++) {
+          out << (d > 0 ? "," : "") << values[(size_t)i*dimensions + d];
+        }
+        out << "\n";
+      }
+    } else {
+      out.write(reinterpret_cast<const char*>(values), sizeof(T) * dimensions * numExamples);
+    }
+
+    if (!out) {
+      throw std::runtime_error("Could not write the output");
+    }
+  }
+
+private:
+  bool csv;
+  std::ofstream out;
+};
+
+// Writes numExamples examples of dimensions values each.
+template<typename T>
+void write_examples(const std::string& filename, unsigned int dimensions, unsigned int numExamples, const T* values)
+{
+  ExampleWriter<T> writer(filename);
+  writer.write(dimensions, numExamples, values);
+}
+
+}
@@ -35,6 +35,14 @@ if mex_modified < cpp_modified
 	compile_file = true;
 end
 
+% Every MEX file includes the headers in this folder.
+headers = dir([my_path filesep '*.h']);
+for i = 1 : length(headers)
+	if mex_modified < headers(i).datenum
+		compile_file = true;
+	end
+end
+
 include_folders = {};
 
 % Append current folder to sources
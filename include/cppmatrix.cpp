@@ -1,4 +1,4 @@
-
-
-// Nothing
-
+
+
+// Nothing
+
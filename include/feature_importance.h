@@ -0,0 +1,159 @@
+// Permutation feature importance of a trained forest.
+#pragma once
+
+#include "sherwood_core.h"
+#include "classify_forest.h"
+#include <vector>
+#include <algorithm>
+
+#if USE_OPENMP == 1
+#include <omp.h>
+#endif
+
+namespace MicrosoftResearch { namespace Cambridge { namespace Sherwood
+{
+
+// Number of misclassified examples of block, which holds the examples
+// first, first+1, ... of data.
+template<typename F>
+double PredictionError(Forest<F, HistogramAggregator>& forest, const DataPointCollection& block,
+                       const DataPointCollection& data, unsigned int first, const Options& options,
+                       std::vector<float>& probabilities)
+{
+  unsigned int num_classes = CountClasses(forest);
+
+  probabilities.assign((size_t)num_classes * block.Count(), 0.0f);
+
+  ClassificationOutputs out;
+  out.probabilities = &probabilities[0];
+  ClassifyForest(forest, block, options, out);
+
+  double errors = 0;
+  for (unsigned int j = 0; j < block.Count(); j++)
+  {
+    const float* P = &probabilities[(size_t)j*num_classes];
+    unsigned int c = (unsigned int)(std::max_element(P, P + num_classes) - P);
+
+    if (c != data.GetIntegerLabel(first + j)) {
+      errors++;
+    }
+  }
+
+  return errors;
+}
+
+// Sum of squared errors of block, which holds the examples first,
+// first+1, ... of data.
+template<typename F>
+double PredictionError(Forest<F, GaussianAggregator1d>& forest, const DataPointCollection& block,
+                       const DataPointCollection& data, unsigned int first, const Options& options,
+                       std::vector<float>& mean)
+{
+  mean.assign(block.Count(), 0.0f);
+
+  RegressionOutputs out;
+  out.mean = &mean[0];
+  RegressForest(forest, block, options, out);
+
+  double errors = 0;
+  for (unsigned int j = 0; j < block.Count(); j++)
+  {
+    double e = mean[j] - data.GetTarget(first + j);
+    errors += e * e;
+  }
+
+  return errors;
+}
+
+// F: Feature Response
+// S: StatisticsAggregator
+//
+// Increase of the error on data when the values of one dimension are
+// permuted over the examples, for each dimension. The error is the
+// misclassification rate for classification and the mean squared error
+// for regression; baselineError is the error without permutation.
+//
+// One permutation of the examples is used for all dimensions. Examples
+// are processed in blocks of ClassifyBlockSize: a block is copied once and
+// its dimensions are permuted one at a time, so only a block is copied per
+// thread. Blocks are processed in parallel with options.MaxThreads.
+template<typename F, typename S>
+std::vector<double> PermutationImportance(Forest<F,S>& forest, const DataPointCollection& data,
+                                          const Options& options, double& baselineError,
+                                          unsigned int seed = 1)
+{
+  unsigned int num_points = data.Count();
+  unsigned int dimensions = data.Dimensions();
+  int num_blocks = (int)((num_points + ClassifyBlockSize - 1) / ClassifyBlockSize);
+
+  // Fisher-Yates, with the high bits of Random.
+  Random random(seed);
+  std::vector<unsigned int> permutation(num_points);
+  for (unsigned int i = 0; i < num_points; i++) {
+    permutation[i] = i;
+  }
+
+  for (unsigned int i = num_points; i > 1; i--) {
+    unsigned int j = std::min(i - 1, (unsigned int)(random.NextDouble() * i));
+    std::swap(permutation[i - 1], permutation[j]);
+  }
+
+  double baseline = 0;
+  std::vector<double> errors(dimensions, 0.0);
+
+  #if USE_OPENMP == 1
+    omp_set_num_threads(std::max(options.MaxThreads, 1));
+  #endif
+
+  #pragma omp parallel
+  {
+    std::vector<float> block((size_t)ClassifyBlockSize * dimensions);
+    std::vector<float> buffer;
+    std::vector<double> threadErrors(dimensions, 0.0);
+    double threadBaseline = 0;
+
+    #pragma omp for schedule(dynamic)
+    for (int b = 0; b < num_blocks; b++)
+    {
+      unsigned int first = b * ClassifyBlockSize;
+      unsigned int count = std::min(ClassifyBlockSize, num_points - first);
+
+      threadBaseline += PredictionError(forest, DataPointCollection(data, first, count), data, first, options, buffer);
+
+      std::copy(data.GetDataPoint(first), data.GetDataPoint(first) + (size_t)count * dimensions, block.begin());
+      DataPointCollection blockData(&block[0], dimensions, count);
+
+      for (unsigned int d = 0; d < dimensions; d++)
+      {
+        for (unsigned int j = 0; j < count; j++) {
+          block[(size_t)j*dimensions + d] = data.GetDataPoint(permutation[first + j])[d];
+        }
+
+        threadErrors[d] += PredictionError(forest, blockData, data, first, options, buffer);
+
+        for (unsigned int j = 0; j < count; j++) {
+          block[(size_t)j*dimensions + d] = data.GetDataPoint(first + j)[d];
+        }
+      }
+    }
+
+    #pragma omp critical
+    {
+      baseline += threadBaseline;
+      for (unsigned int d = 0; d < dimensions; d++) {
+        errors[d] += threadErrors[d];
+      }
+    }
+  }
+
+  baselineError = num_points > 0 ? baseline / num_points : 0;
+
+  std::vector<double> importance(dimensions, 0.0);
+  for (unsigned int d = 0; d < dimensions && num_points > 0; d++) {
+    importance[d] = errors[d] / num_points - baselineError;
+  }
+
+  return importance;
+}
+
+}}}
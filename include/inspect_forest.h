@@ -0,0 +1,136 @@
+// Structure of a trained forest, computed in one pass over the nodes of
+// the loaded forest.
+#pragma once
+
+#include "sherwood_core.h"
+#include <vector>
+#include <algorithm>
+
+namespace MicrosoftResearch { namespace Cambridge { namespace Sherwood
+{
+
+// Heap memory owned by features and statistics, in bytes.
+size_t HeapBytes(const AxisAlignedFeatureResponse&)
+{
+  return 0;
+}
+
+size_t HeapBytes(const RandomHyperplaneFeatureResponse& feature)
+{
+  return feature.n.capacity() * sizeof(float);
+}
+
+size_t HeapBytes(const RandomHyperplaneFeatureResponseNormalized& feature)
+{
+  return feature.n.capacity() * sizeof(float) + feature.featureStats.capacity() * sizeof(Stats);
+}
+
+size_t HeapBytes(const HistogramAggregator& aggregator)
+{
+  return aggregator.bins_.capacity() * sizeof(unsigned int) +
+    aggregator.sparseBins_.capacity() * sizeof(HistogramAggregator::SparseBin);
+}
+
+size_t HeapBytes(const GaussianAggregator1d&)
+{
+  return 0;
+}
+
+// Depth of node n, the root has depth 0.
+unsigned int NodeDepth(unsigned int n)
+{
+  unsigned int depth = 0;
+  for (n = n + 1; n > 1; n >>= 1) {
+    depth++;
+  }
+  return depth;
+}
+
+struct ForestSummary
+{
+  unsigned int TreeCount;
+  // Number of depths in DepthHistogram, one more than the deepest
+  // possible leaf.
+  unsigned int Levels;
+
+  // Per tree: nodes in use (split nodes and leaves), leaves, depth of
+  // the deepest leaf and memory of the tree in bytes.
+  std::vector<unsigned int> NodeCount;
+  std::vector<unsigned int> LeafCount;
+  std::vector<unsigned int> Depth;
+  std::vector<double> Bytes;
+
+  // Number of leaves at each depth ordered as (depth, tree)
+  std::vector<unsigned int> DepthHistogram;
+
+  // One element per leaf: zero based tree and node index (as the leaves
+  // returned by classification) and the number of training samples.
+  std::vector<unsigned int> LeafTree;
+  std::vector<unsigned int> LeafNode;
+  std::vector<unsigned int> LeafSamples;
+
+  // Number of split nodes using each dimension; for hyperplanes the
+  // absolute weights of a split node are normalized to sum to one.
+  std::vector<double> FeatureUsage;
+
+  ForestSummary()
+  : TreeCount(0), Levels(0)
+  {}
+};
+
+// F: Feature Response
+// S: StatisticsAggregator
+template<typename F, typename S>
+ForestSummary SummarizeForest(const Forest<F,S>& forest)
+{
+  ForestSummary summary;
+  summary.TreeCount = forest.TreeCount();
+
+  for (unsigned int t = 0; t < summary.TreeCount; t++) {
+    summary.Levels = std::max(summary.Levels, NodeDepth(forest.GetTree(t).NodeCount() - 1) + 1);
+  }
+
+  summary.NodeCount.resize(summary.TreeCount, 0);
+  summary.LeafCount.resize(summary.TreeCount, 0);
+  summary.Depth.resize(summary.TreeCount, 0);
+  summary.Bytes.resize(summary.TreeCount, 0.0);
+  summary.DepthHistogram.resize((size_t)summary.Levels * summary.TreeCount, 0);
+
+  for (unsigned int t = 0; t < summary.TreeCount; t++)
+  {
+    const Tree<F,S>& tree = forest.GetTree(t);
+    double bytes = (double)tree.NodeCount() * sizeof(Node<F,S>);
+
+    for (int n = 0; n < tree.NodeCount(); n++)
+    {
+      const Node<F,S>& node = tree.GetNode(n);
+
+      if (node.IsNull())
+        continue;
+
+      summary.NodeCount[t]++;
+      bytes += HeapBytes(node.Feature) + HeapBytes(node.TrainingDataStatistics);
+
+      if (node.IsSplit()) {
+        AddFeatureUsage(node.Feature, 1.0, summary.FeatureUsage);
+        continue;
+      }
+
+      unsigned int depth = NodeDepth(n);
+
+      summary.LeafCount[t]++;
+      summary.Depth[t] = std::max(summary.Depth[t], depth);
+      summary.DepthHistogram[(size_t)t*summary.Levels + depth]++;
+
+      summary.LeafTree.push_back(t);
+      summary.LeafNode.push_back(n);
+      summary.LeafSamples.push_back(node.TrainingDataStatistics.SampleCount());
+    }
+
+    summary.Bytes[t] = bytes;
+  }
+
+  return summary;
+}
+
+}}}
@@ -0,0 +1,592 @@
+// Forests in a flat, position independent layout, used in place from a
+// read-only memory mapped file. Processes classifying with the same packed
+// forest (e.g. the workers of parfor) share one copy of it in memory, and
+// attaching to it does not deserialize anything.
+#pragma once
+
+#include "sherwood_core.h"
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <fstream>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace MicrosoftResearch { namespace Cambridge { namespace Sherwood
+{
+
+// Offsets in the packed layout are relative to the address of the offset
+// itself, so the layout is valid wherever the file is mapped.
+template<typename T>
+const T* PackedPointer(const long long& offset)
+{
+  return (const T*)((const char*)&offset + offset);
+}
+
+struct PackedAxisAligned
+{
+  unsigned int axis;
+  unsigned int unused;
+
+  // As AxisAlignedFeatureResponse::GetResponse.
+  float GetResponse(const IDataPointCollection& data, unsigned int sampleIndex) const
+  {
+    const DataPointCollection& concreteData = (const DataPointCollection&)(data);
+    return concreteData.GetFeature(sampleIndex, axis);
+  }
+};
+
+struct PackedHyperplane
+{
+  unsigned int dimensions;
+  unsigned int unused;
+  long long n;
+
+  // As RandomHyperplaneFeatureResponse::GetResponse.
+  float GetResponse(const IDataPointCollection& data, unsigned int index) const
+  {
+    const DataPointCollection& concreteData = (const DataPointCollection&)(data);
+    const float* w = PackedPointer<float>(n);
+    const float* x = concreteData.GetDataPoint(index);
+
+    float response = w[0] * x[0];
+    for (unsigned int c = 1; c < dimensions; c++) {
+      response += w[c] * x[c];
+    }
+
+    return response;
+  }
+};
+
+struct PackedHyperplaneNormalized
+{
+  unsigned int dimensions;
+  unsigned int unused;
+  long long n;
+  long long featureStats;
+
+  // As RandomHyperplaneFeatureResponseNormalized::GetResponse.
+  float GetResponse(const IDataPointCollection& data, unsigned int index) const
+  {
+    const DataPointCollection& concreteData = (const DataPointCollection&)(data);
+    const float* w = PackedPointer<float>(n);
+    const Stats* stats = PackedPointer<Stats>(featureStats);
+    const float* x = concreteData.GetDataPoint(index);
+
+    float response = w[0] * ((x[0] - stats[0].mean) / stats[0].stdev);
+    for (unsigned int c = 1; c < dimensions; c++) {
+      response += w[c] * ((x[c] - stats[c].mean) / stats[c].stdev);
+    }
+
+    return response;
+  }
+};
+
+// The non-zero bins of a HistogramAggregator, sorted by class. The results
+// are those of HistogramAggregator, whose zero bins add nothing.
+struct PackedHistogram
+{
+  typedef HistogramAggregator::SparseBin SparseBin;
+
+  unsigned int binCount;
+  unsigned int sampleCount;
+  unsigned int binsUsed;
+  unsigned int unused;
+  long long bins;
+
+  unsigned int BinCount() const
+  {
+    return binCount;
+  }
+
+  unsigned int SampleCount() const
+  {
+    return sampleCount;
+  }
+
+  unsigned int GetCount(unsigned int classIndex) const
+  {
+    const SparseBin* sparse = PackedPointer<SparseBin>(bins);
+    const SparseBin* it = std::lower_bound(sparse, sparse + binsUsed, SparseBin(classIndex, 0));
+
+    return it == sparse + binsUsed || it->first != classIndex ? 0 : it->second;
+  }
+
+  float GetProbability(unsigned int classIndex) const
+  {
+    return (float)(GetCount(classIndex)) / sampleCount;
+  }
+
+  unsigned int FindTallestBinIndex() const
+  {
+    const SparseBin* sparse = PackedPointer<SparseBin>(bins);
+    unsigned int maxCount = 0;
+    unsigned int tallestBinIndex = 0;
+
+    for (unsigned int i = 0; i < binsUsed; i++)
+    {
+      if (sparse[i].second > maxCount)
+      {
+        maxCount = sparse[i].second;
+        tallestBinIndex = sparse[i].first;
+      }
+    }
+
+    return tallestBinIndex;
+  }
+
+  template<typename T>
+  void AccumulateCounts(T* out) const
+  {
+    const SparseBin* sparse = PackedPointer<SparseBin>(bins);
+    for (unsigned int i = 0; i < binsUsed; i++)
+      out[sparse[i].first] += sparse[i].second;
+  }
+
+  template<typename T>
+  void AccumulateProbabilities(T* out) const
+  {
+    if (sampleCount == 0)
+      return;
+
+    T scale = T(1) / sampleCount;
+
+    const SparseBin* sparse = PackedPointer<SparseBin>(bins);
+    for (unsigned int i = 0; i < binsUsed; i++)
+      out[sparse[i].first] += scale * sparse[i].second;
+  }
+};
+
+struct PackedGaussian
+{
+  double mean;
+  double variance;
+
+  double Mean() const
+  {
+    return mean;
+  }
+
+  double Variance() const
+  {
+    return variance;
+  }
+};
+
+template<typename PF, typename PS>
+struct PackedNode
+{
+  static const unsigned int Leaf = 1;
+  static const unsigned int Split = 2;
+
+  unsigned int flags;
+  float Threshold;
+  PF Feature;
+  PS TrainingDataStatistics;
+
+  bool IsLeaf() const
+  {
+    return flags == Leaf;
+  }
+
+  bool IsSplit() const
+  {
+    return flags == Split;
+  }
+
+  bool IsNull() const
+  {
+    return flags == 0;
+  }
+};
+
+template<typename PF, typename PS>
+struct PackedTree
+{
+  typedef PackedNode<PF,PS> NodeType;
+
+  unsigned int nodeCount;
+  unsigned int unused;
+  long long nodes;
+
+  int NodeCount() const
+  {
+    return (int)nodeCount;
+  }
+
+  const NodeType& GetNode(int index) const
+  {
+    return PackedPointer<NodeType>(nodes)[index];
+  }
+
+  // As Tree::Apply.
+  void Apply(const IDataPointCollection& data, std::vector<int>& leafNodeIndices) const
+  {
+    leafNodeIndices.resize(data.Count());
+
+    for (unsigned int i = 0; i < data.Count(); i++)
+    {
+      int n = 0;
+      while (!GetNode(n).IsLeaf()) {
+        n = GetNode(n).Feature.GetResponse(data, i) < GetNode(n).Threshold ? 2*n + 1 : 2*n + 2;
+      }
+      leafNodeIndices[i] = n;
+    }
+  }
+};
+
+struct PackedHeader
+{
+  char magic[8];
+  unsigned int version;
+  unsigned int featureType;
+  unsigned int statisticsType;
+  unsigned int treeCount;
+  long long trees;
+};
+
+const char PackedMagic[8] = {'S', 'H', 'W', 'D', 'P', 'A', 'C', 'K'};
+const unsigned int PackedVersion = 1;
+
+// The image of a packed forest being written. Everything is 8 byte aligned.
+class PackedImage
+{
+public:
+  std::vector<char> bytes;
+
+  // Position of size zero-filled bytes added at the end.
+  size_t Reserve(size_t size)
+  {
+    size_t position = (bytes.size() + 7) & ~(size_t)7;
+    bytes.resize(position + size, 0);
+    return position;
+  }
+
+  size_t Append(const void* data, size_t size)
+  {
+    size_t position = Reserve(size);
+    if (size > 0) {
+      memcpy(&bytes[position], data, size);
+    }
+    return position;
+  }
+
+  // Offset to target for the offset field at position, see PackedPointer.
+  static long long Offset(size_t position, size_t target)
+  {
+    return (long long)target - (long long)position;
+  }
+};
+
+// Packed type of each feature response and statistics aggregator. Pack
+// fills packed, which is written at position of image; its arrays are
+// appended to image.
+template<typename F> struct PackedType;
+
+template<> struct PackedType<AxisAlignedFeatureResponse>
+{
+  typedef PackedAxisAligned Type;
+  static const unsigned int Id = 1;
+
+  static void Pack(const AxisAlignedFeatureResponse& feature, Type& packed, PackedImage&, size_t)
+  {
+    packed.axis = feature.Axis();
+  }
+};
+
+template<> struct PackedType<RandomHyperplaneFeatureResponse>
+{
+  typedef PackedHyperplane Type;
+  static const unsigned int Id = 2;
+
+  static void Pack(const RandomHyperplaneFeatureResponse& feature, Type& packed, PackedImage& image, size_t position)
+  {
+    packed.dimensions = feature.dimensions;
+    size_t n = image.Append(feature.n.empty() ? 0 : &feature.n[0], feature.n.size() * sizeof(float));
+    packed.n = PackedImage::Offset(position + ((char*)&packed.n - (char*)&packed), n);
+  }
+};
+
+template<> struct PackedType<RandomHyperplaneFeatureResponseNormalized>
+{
+  typedef PackedHyperplaneNormalized Type;
+  static const unsigned int Id = 3;
+
+  static void Pack(const RandomHyperplaneFeatureResponseNormalized& feature, Type& packed, PackedImage& image, size_t position)
+  {
+    packed.dimensions = feature.dimensions;
+    size_t n = image.Append(feature.n.empty() ? 0 : &feature.n[0], feature.n.size() * sizeof(float));
+    size_t stats = image.Append(feature.featureStats.empty() ? 0 : &feature.featureStats[0], feature.featureStats.size() * sizeof(Stats));
+    packed.n = PackedImage::Offset(position + ((char*)&packed.n - (char*)&packed), n);
+    packed.featureStats = PackedImage::Offset(position + ((char*)&packed.featureStats - (char*)&packed), stats);
+  }
+};
+
+template<> struct PackedType<HistogramAggregator>
+{
+  typedef PackedHistogram Type;
+  static const unsigned int Id = 1;
+
+  static void Pack(const HistogramAggregator& aggregator, Type& packed, PackedImage& image, size_t position)
+  {
+    std::vector<HistogramAggregator::SparseBin> bins;
+
+    if (aggregator.IsSparse()) {
+      bins = aggregator.sparseBins_;
+    } else {
+      for (unsigned int c = 0; c < aggregator.BinCount(); c++) {
+        if (aggregator.Bins()[c] > 0) {
+          bins.push_back(HistogramAggregator::SparseBin(c, aggregator.Bins()[c]));
+        }
+      }
+    }
+
+    packed.binCount = aggregator.BinCount();
+    packed.sampleCount = aggregator.SampleCount();
+    packed.binsUsed = (unsigned int)bins.size();
+
+    size_t data = image.Append(bins.empty() ? 0 : &bins[0], bins.size() * sizeof(HistogramAggregator::SparseBin));
+    packed.bins = PackedImage::Offset(position + ((char*)&packed.bins - (char*)&packed), data);
+  }
+};
+
+template<> struct PackedType<GaussianAggregator1d>
+{
+  typedef PackedGaussian Type;
+  static const unsigned int Id = 2;
+
+  static void Pack(const GaussianAggregator1d& aggregator, Type& packed, PackedImage&, size_t)
+  {
+    packed.mean = aggregator.Mean();
+    packed.variance = aggregator.Variance();
+  }
+};
+
+// F: Feature Response
+// S: StatisticsAggregator
+//
+// Writes forest in the packed layout to filename.
+template<typename F, typename S>
+void PackForest(const Forest<F,S>& forest, const std::string& filename)
+{
+  typedef PackedTree<typename PackedType<F>::Type, typename PackedType<S>::Type> TreeType;
+  typedef typename TreeType::NodeType NodeType;
+
+  PackedImage image;
+
+  PackedHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, PackedMagic, sizeof(PackedMagic));
+  header.version = PackedVersion;
+  header.featureType = PackedType<F>::Id;
+  header.statisticsType = PackedType<S>::Id;
+  header.treeCount = forest.TreeCount();
+
+  size_t headerPosition = image.Reserve(sizeof(PackedHeader));
+  size_t treesPosition = image.Reserve(sizeof(TreeType) * header.treeCount);
+  header.trees = PackedImage::Offset(headerPosition + ((char*)&header.trees - (char*)&header), treesPosition);
+  memcpy(&image.bytes[headerPosition], &header, sizeof(header));
+
+  for (int t = 0; t < forest.TreeCount(); t++)
+  {
+    const Tree<F,S>& tree = forest.GetTree(t);
+    size_t treePosition = treesPosition + t * sizeof(TreeType);
+    size_t nodesPosition = image.Reserve(sizeof(NodeType) * tree.NodeCount());
+
+    TreeType packedTree;
+    memset(&packedTree, 0, sizeof(packedTree));
+    packedTree.nodeCount = tree.NodeCount();
+    packedTree.nodes = PackedImage::Offset(treePosition + ((char*)&packedTree.nodes - (char*)&packedTree), nodesPosition);
+    memcpy(&image.bytes[treePosition], &packedTree, sizeof(packedTree));
+
+    for (int n = 0; n < tree.NodeCount(); n++)
+    {
+      const Node<F,S>& node = tree.GetNode(n);
+      size_t nodePosition = nodesPosition + n * sizeof(NodeType);
+
+      NodeType packed;
+      memset(&packed, 0, sizeof(packed));
+
+      if (!node.IsNull())
+      {
+        packed.flags = node.IsLeaf() ? NodeType::Leaf : NodeType::Split;
+        packed.Threshold = node.Threshold;
+
+        PackedType<F>::Pack(node.Feature, packed.Feature, image,
+                            nodePosition + ((char*)&packed.Feature - (char*)&packed));
+        PackedType<S>::Pack(node.TrainingDataStatistics, packed.TrainingDataStatistics, image,
+                            nodePosition + ((char*)&packed.TrainingDataStatistics - (char*)&packed));
+      }
+
+      memcpy(&image.bytes[nodePosition], &packed, sizeof(packed));
+    }
+  }
+
+  std::ofstream o(filename.c_str(), std::ios_base::binary);
+  o.write(&image.bytes[0], image.bytes.size());
+
+  if (!o) {
+    throw std::runtime_error("Could not write " + filename);
+  }
+}
+
+// A file mapped read-only into memory.
+class MappedFile
+{
+public:
+  MappedFile(const std::string& filename)
+  : data_(0), size_(0)
+  {
+#ifdef _WIN32
+    mapping_ = 0;
+    file_ = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    if (file_ == INVALID_HANDLE_VALUE) {
+      throw std::runtime_error("Could not open " + filename);
+    }
+
+    LARGE_INTEGER size;
+    GetFileSizeEx(file_, &size);
+    size_ = (size_t)size.QuadPart;
+
+    mapping_ = CreateFileMappingA(file_, 0, PAGE_READONLY, 0, 0, 0);
+    data_ = mapping_ ? (const char*)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0) : 0;
+#else
+    int file = open(filename.c_str(), O_RDONLY);
+    if (file < 0) {
+      throw std::runtime_error("Could not open " + filename);
+    }
+
+    struct stat status;
+    if (fstat(file, &status) == 0 && status.st_size > 0)
+    {
+      size_ = (size_t)status.st_size;
+      void* data = mmap(0, size_, PROT_READ, MAP_SHARED, file, 0);
+      data_ = data == MAP_FAILED ? 0 : (const char*)data;
+    }
+
+    close(file);
+#endif
+
+    if (!data_) {
+      Unmap();
+      throw std::runtime_error("Could not map " + filename);
+    }
+  }
+
+  ~MappedFile()
+  {
+    Unmap();
+  }
+
+  const char* Data() const
+  {
+    return data_;
+  }
+
+  size_t Size() const
+  {
+    return size_;
+  }
+
+private:
+  // Not copyable.
+  MappedFile(const MappedFile&);
+  MappedFile& operator=(const MappedFile&);
+
+  void Unmap()
+  {
+#ifdef _WIN32
+    if (data_) UnmapViewOfFile(data_);
+    if (mapping_) CloseHandle(mapping_);
+    if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+#else
+    if (data_) munmap((void*)data_, size_);
+#endif
+    data_ = 0;
+  }
+
+  const char* data_;
+  size_t size_;
+#ifdef _WIN32
+  HANDLE file_;
+  HANDLE mapping_;
+#endif
+};
+
+// A packed forest mapped from its file, with the interface of Forest used
+// by ClassifyForest and RegressForest.
+template<typename F, typename S>
+class PackedForest
+{
+public:
+  typedef PackedTree<typename PackedType<F>::Type, typename PackedType<S>::Type> TreeType;
+  typedef typename PackedType<S>::Type StatisticsType;
+
+  PackedForest(const std::string& filename)
+  : file_(filename)
+  {
+    header_ = (const PackedHeader*)file_.Data();
+
+    if (file_.Size() < sizeof(PackedHeader) || memcmp(header_->magic, PackedMagic, sizeof(PackedMagic)) != 0 ||
+        header_->version != PackedVersion) {
+      throw std::runtime_error(filename + " is not a packed forest");
+    }
+
+    if (header_->featureType != PackedType<F>::Id || header_->statisticsType != PackedType<S>::Id) {
+      throw std::runtime_error(filename + " was packed with another WeakLearner, FeatureScaling or Task");
+    }
+
+    // The trees and nodes must lie within the file, the arrays the nodes
+    // refer to are trusted.
+    if (!Within((const char*)&GetTree(0), TreeCount() * sizeof(TreeType))) {
+      throw std::runtime_error(filename + " is truncated");
+    }
+
+    for (int t = 0; t < TreeCount(); t++)
+    {
+      const TreeType& tree = GetTree(t);
+      if (!Within((const char*)&tree.GetNode(0), tree.NodeCount() * sizeof(typename TreeType::NodeType))) {
+        throw std::runtime_error(filename + " is truncated");
+      }
+    }
+  }
+
+  int TreeCount() const
+  {
+    return (int)header_->treeCount;
+  }
+
+  const TreeType& GetTree(int index) const
+  {
+    return PackedPointer<TreeType>(header_->trees)[index];
+  }
+
+private:
+  bool Within(const char* data, size_t size) const
+  {
+    return data >= file_.Data() && data <= file_.Data() + file_.Size() &&
+      size <= (size_t)(file_.Data() + file_.Size() - data);
+  }
+
+  MappedFile file_;
+  const PackedHeader* header_;
+};
+
+// True if filename starts as a packed forest.
+bool IsPackedForest(const std::string& filename)
+{
+  std::ifstream istream(filename.c_str(), std::ios_base::binary);
+
+  char magic[sizeof(PackedMagic)];
+  return istream.read(magic, sizeof(magic)) && memcmp(magic, PackedMagic, sizeof(PackedMagic)) == 0;
+}
+
+}}}
@@ -0,0 +1,134 @@
+// Command line classification, see cliutils.h for the file formats.
+//
+// sherwood-classify features forest output [Key=Value ...]
+//
+// The keys are the same as SherwoodSettings and must match the settings
+// used for training. Dimensions is needed for binary feature files.
+// ChunkSize is the number of examples held in memory at a time.
+// Each example of the output holds the class probabilities (classification)
+// or the predicted target and its variance (regression).
+#include "sherwood_core.h"
+#include "classify_forest.h"
+#include "cliutils.h"
+
+using namespace MicrosoftResearch::Cambridge::Sherwood;
+
+// Examples are read, classified and written ChunkSize at a time, so
+// memory does not grow with the size of the feature file.
+template<typename F>
+void classify(ExampleReader<float>& reader, unsigned int chunkSize, const Options& options, const std::string& outputName)
+{
+  std::auto_ptr<Forest<F, HistogramAggregator> > forest = LoadForest<F, HistogramAggregator>(options.ForestName);
+
+  unsigned int num_classes = CountClasses(*forest);
+  ExampleWriter<float> writer(outputName);
+
+  std::vector<float> features;
+  std::vector<float> probabilities;
+  unsigned int count, total = 0;
+
+  while ((count = reader.read(features, chunkSize)) > 0)
+  {
+    DataPointCollection testData(&features[0], reader.dimensions(), count);
+    probabilities.assign((size_t)num_classes * count, 0.0f);
+
+    ClassificationOutputs out;
+    out.probabilities = &probabilities[0];
+
+    ClassifyForest(*forest, testData, options, out);
+
+    writer.write(num_classes, count, &probabilities[0]);
+    total += count;
+  }
+
+  if (total == 0) {
+    throw std::runtime_error("No test data.");
+  }
+}
+
+template<typename F>
+void regress(ExampleReader<float>& reader, unsigned int chunkSize, const Options& options, const std::string& outputName)
+{
+  std::auto_ptr<Forest<F, GaussianAggregator1d> > forest = LoadForest<F, GaussianAggregator1d>(options.ForestName);
+
+  ExampleWriter<float> writer(outputName);
+
+  std::vector<float> features;
+  std::vector<float> mean, variance, output;
+  unsigned int count, total = 0;
+
+  while ((count = reader.read(features, chunkSize)) > 0)
+  {
+    DataPointCollection testData(&features[0], reader.dimensions(), count);
+    mean.assign(count, 0.0f);
+    variance.assign(count, 0.0f);
+
+    RegressionOutputs out;
+    out.mean = &mean[0];
+    out.variance = &variance[0];
+
+    RegressForest(*forest, testData, options, out);
+
+    output.resize(2 * count);
+    for (unsigned int i = 0; i < count; i++) {
+      output[2*i] = mean[i];
+      output[2*i + 1] = variance[i];
+    }
+
+    writer.write(2, count, &output[0]);
+    total += count;
+  }
+
+  if (total == 0) {
+    throw std::runtime_error("No test data.");
+  }
+}
+
+template<typename F>
+void run(ExampleReader<float>& reader, unsigned int chunkSize, const Options& options, const std::string& outputName)
+{
+  if (options.Task == Regression) {
+    regress<F>(reader, chunkSize, options, outputName);
+  } else {
+    classify<F>(reader, chunkSize, options, outputName);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 4) {
+    fprintf(stderr, "Usage: %s features forest output [Key=Value ...]\n", argv[0]);
+    return 1;
+  }
+
+  try {
+    CliParams params(argc - 4, argv + 4);
+    Options options(params);
+    options.ForestName = argv[2];
+
+    unsigned int dimensions = params.get<int>("Dimensions", 0);
+    int chunkSize = params.get<int>("ChunkSize", 16 * ClassifyBlockSize);
+
+    if (chunkSize <= 0) {
+      throw std::runtime_error("ChunkSize must be positive.");
+    }
+
+    ExampleReader<float> reader(argv[1], dimensions);
+
+    if (options.WeakLearner == AxisAligned) {
+      run<AxisAlignedFeatureResponse>(reader, chunkSize, options, argv[3]);
+    }
+    else if (options.WeakLearner == RandomHyperplane && !options.FeatureScaling) {
+      run<RandomHyperplaneFeatureResponse>(reader, chunkSize, options, argv[3]);
+    }
+    else if (options.WeakLearner == RandomHyperplane && options.FeatureScaling) {
+      run<RandomHyperplaneFeatureResponseNormalized>(reader, chunkSize, options, argv[3]);
+    }
+  }
+  catch (std::exception& e) {
+    fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+
+  return 0;
+}
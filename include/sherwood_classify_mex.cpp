@@ -1,108 +1,325 @@
-#include "sherwood_mex.h"
-
-using namespace MicrosoftResearch::Cambridge::Sherwood;
-
-// F: Feature Response
-// S: StatisticsAggregator
-template<typename F, typename S>
-void main_function(int nlhs, 		    /* number of expected outputs */
-        mxArray        *plhs[],	    /* mxArray output pointer array */
-        int            nrhs, 		/* number of inputs */
-        const mxArray  *prhs[],		/* mxArray input pointer array */
-        Options options)
-{
-	unsigned int curarg = 0;
-	const matrix<float> features = prhs[curarg++];
-
-  if (options.Verbose) {
-    mexPrintf("Loading tree at: %s\n", options.ForestName.c_str());
-    mexPrintf("TreeAggregator: %s. \n", options.TreeAggregatorStr.c_str());
-  }
- 
-	// Point class
-	DataPointCollection testData(features);  
-
-	// Create the tree.
-	std::auto_ptr<Forest<F, S> > forest;
-
-	// Load the tree from file 
-  std::ifstream istream(options.ForestName.c_str(), std::ios_base::binary);
-  forest = forest->Deserialize(istream);
-
-  unsigned int num_classes = forest->GetTree(0).GetNode(0).TrainingDataStatistics.BinCount();
-
-  if (options.Verbose) 
-  {
-    mexPrintf("Number of classes: %d\n", num_classes);
-    mexPrintf("Number of test data: %d\n", testData.Count());
-  }
-
-  // Output ordered as (class, index)
-  matrix<double> output(num_classes,testData.Count());
-
-  for (int i = 0; i < output.numel(); i++) {
-    output(i) = 0;
-  }
-  
-  // Perform classification
-  // forest::apply is wasting memory, bypassing it.
-  //
-  // Note: leafNodeIndices should unsigned int, modify tree.h and the line below.
-  //
-  std::vector<int> leafNodeIndices;
-
-  // Forest.h (Apply)
-  for (unsigned int t = 0; t < forest->TreeCount(); t++)
-  {
-    Tree<F,S>& tree = forest->GetTree(t);
-
-    // Tree.h
-    tree.Apply(testData, leafNodeIndices);
-
-    // Aggregate histograms
-    if (options.TreeAggregator == Histogram) {
-
-      for (unsigned int i = 0; i < testData.Count(); i++)
-      { 
-        S aggregator = tree.GetNode(leafNodeIndices[i]).TrainingDataStatistics;
-
-        for (unsigned int c = 0; c < num_classes; c++) {
-          output(c,i) += aggregator.bins_[c];
-        }
-      }
- 
-    // Aggregate probabilities
-    } else if (options.TreeAggregator ==  Probability) {
-      for (unsigned int i = 0; i < testData.Count(); i++)
-      { 
-        S aggregator = tree.GetNode(leafNodeIndices[i]).TrainingDataStatistics;
-
-        for (unsigned int c = 0; c < num_classes; c++) {
-          output(c,i) += aggregator.GetProbability(c);
-        }
-      }
-
-    } 
-
-    leafNodeIndices.clear();
-  }
-
-  plhs[0] = output;
-}
-
-void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray  *prhs[])
-{
-  MexParams params(1, prhs+1);
-  Options options(params);
-
-  if (options.WeakLearner == AxisAligned) {
-    main_function<AxisAlignedFeatureResponse, HistogramAggregator>(nlhs, plhs, nrhs, prhs, options);
-  }
-  else if (options.WeakLearner == RandomHyperplane && !options.FeatureScaling) {
-    main_function<RandomHyperplaneFeatureResponse, HistogramAggregator>(nlhs, plhs, nrhs, prhs, options);
-  }
-  else if (options.WeakLearner == RandomHyperplane && options.FeatureScaling) {
-    main_function<RandomHyperplaneFeatureResponseNormalized, HistogramAggregator>(nlhs, plhs, nrhs, prhs, options);
-  }
-
-}
\ No newline at end of file
+#include "sherwood_mex.h"
+#include "classify_forest.h"
+
+using namespace MicrosoftResearch::Cambridge::Sherwood;
+
+// ForestType: Forest or PackedForest
+//
+// Outputs:
+// 0: normalized class probabilities (single) ordered as (class, index)
+// 1: summed histograms (uint32) or summed probabilities (single) ordered as (class, index)
+// 2: zero based leaf node index (uint32) ordered as (tree, index)
+// 3: tree probabilities (single) ordered as (class, tree, index)
+// 4: number of trees evaluated (uint32) for each index
+//
+// See ClassifyForest for EarlyExit.
+template<typename ForestType>
+void classify_function(ForestType& forest,
+        const DataPointCollection& testData,
+        int            nlhs,
+        mxArray        *plhs[],
+        const Options& options)
+{
+  unsigned int num_classes = CountClasses(forest);
+  unsigned int num_trees = forest.TreeCount();
+  unsigned int num_points = testData.Count();
+
+  if (options.Verbose) 
+  {
+    mexPrintf("Number of classes: %d\n", num_classes);
+    mexPrintf("Number of test data: %d\n", num_points);
+  }
+
+  bool histogram = options.TreeAggregator == Histogram;
+
+  // Outputs are zero initialized by MATLAB. Optional outputs are empty 
+  // if not requested.
+  matrix<float> output(num_classes, num_points);
+  matrix<unsigned int> counts(nlhs > 1 && histogram ? num_classes : 0, nlhs > 1 && histogram ? num_points : 0);
+  matrix<float> probabilitySums(nlhs > 1 && !histogram ? num_classes : 0, nlhs > 1 && !histogram ? num_points : 0);
+  matrix<unsigned int> leaves(nlhs > 2 ? num_trees : 0, nlhs > 2 ? num_points : 0);
+  matrix<float> treeProbabilities(nlhs > 3 ? num_classes : 0, num_trees, nlhs > 3 ? num_points : 0);
+  matrix<unsigned int> treesEvaluated(1, nlhs > 4 ? num_points : 0);
+
+  ClassificationOutputs out;
+  out.probabilities = output.data;
+  out.counts = nlhs > 1 && histogram ? counts.data : 0;
+  out.probabilitySums = nlhs > 1 && !histogram ? probabilitySums.data : 0;
+  out.leaves = nlhs > 2 ? leaves.data : 0;
+  out.treeProbabilities = nlhs > 3 ? treeProbabilities.data : 0;
+  out.treesEvaluated = nlhs > 4 ? treesEvaluated.data : 0;
+
+  ClassifyForest(forest, testData, options, out);
+
+  plhs[0] = output;
+
+  if (nlhs > 1) {
+    plhs[1] = histogram ? (mxArray*)counts : (mxArray*)probabilitySums;
+  }
+
+  if (nlhs > 2) {
+    plhs[2] = leaves;
+  }
+
+  if (nlhs > 3) {
+    plhs[3] = treeProbabilities;
+  }
+
+  if (nlhs > 4) {
+    plhs[4] = treesEvaluated;
+  }
+}
+
+// F: Feature Response
+// S: StatisticsAggregator
+//
+// settings.ForestName is either a forest saved by training or a packed
+// forest (see sherwood_pack), which is mapped instead of loaded.
+template<typename F, typename S>
+void main_function(int nlhs, 		    /* number of expected outputs */
+        mxArray        *plhs[],	    /* mxArray output pointer array */
+        int            nrhs, 		/* number of inputs */
+        const mxArray  *prhs[],		/* mxArray input pointer array */
+        Options options)
+{
+	unsigned int curarg = 0;
+	const mxArray* features = prhs[curarg++];
+
+  if (options.Verbose) {
+    mexPrintf("Loading tree at: %s\n", options.ForestName.c_str());
+    mexPrintf("TreeAggregator: %s. \n", options.TreeAggregatorStr.c_str());
+  }
+ 
+	// Point class
+	DataPointCollection testData = MexTestDataPointCollection(features);  
+
+  if (IsPackedForest(options.ForestName)) {
+    PackedForest<F, S> forest(options.ForestName);
+    classify_function(forest, testData, nlhs, plhs, options);
+    return;
+  }
+
+	// Load the tree from file 
+	std::auto_ptr<Forest<F, S> > forest = LoadForest<F, S>(options.ForestName);
+  classify_function(*forest, testData, nlhs, plhs, options);
+}
+
+// ForestType: Forest or PackedForest of GaussianAggregator1d
+// Regression forest
+//
+// Outputs:
+// 0: mean of the tree predictions (single)
+// 1: predictive variance, the mean of the leaf variances plus the 
+//    variance of the tree predictions (single)
+// 2: zero based leaf node index (uint32) ordered as (tree, index)
+// 3: tree predictions (single) ordered as (tree, index)
+// 4: number of trees evaluated (uint32), always all trees
+template<typename ForestType>
+void regress_function(ForestType& forest,
+        const DataPointCollection& testData,
+        int            nlhs,
+        mxArray        *plhs[],
+        const Options& options)
+{
+  unsigned int num_trees = forest.TreeCount();
+  unsigned int num_points = testData.Count();
+
+  if (options.Verbose) 
+  {
+    mexPrintf("Number of test data: %d\n", num_points);
+  }
+
+  matrix<float> output(1, num_points);
+  matrix<float> variance(1, nlhs > 1 ? num_points : 0);
+  matrix<unsigned int> leaves(nlhs > 2 ? num_trees : 0, nlhs > 2 ? num_points : 0);
+  matrix<float> treePredictions(nlhs > 3 ? num_trees : 0, nlhs > 3 ? num_points : 0);
+  matrix<unsigned int> treesEvaluated(1, nlhs > 4 ? num_points : 0);
+
+  RegressionOutputs out;
+  out.mean = output.data;
+  out.variance = nlhs > 1 ? variance.data : 0;
+  out.leaves = nlhs > 2 ? leaves.data : 0;
+  out.treePredictions = nlhs > 3 ? treePredictions.data : 0;
+  out.treesEvaluated = nlhs > 4 ? treesEvaluated.data : 0;
+
+  RegressForest(forest, testData, options, out);
+
+  plhs[0] = output;
+
+  if (nlhs > 1) {
+    plhs[1] = variance;
+  }
+
+  if (nlhs > 2) {
+    plhs[2] = leaves;
+  }
+
+  if (nlhs > 3) {
+    plhs[3] = treePredictions;
+  }
+
+  if (nlhs > 4) {
+    plhs[4] = treesEvaluated;
+  }
+}
+
+// F: Feature Response
+// As main_function for regression.
+template<typename F>
+void regression_function(int nlhs,
+        mxArray        *plhs[],
+        int            nrhs,
+        const mxArray  *prhs[],
+        Options options)
+{
+	unsigned int curarg = 0;
+	const mxArray* features = prhs[curarg++];
+
+  if (options.Verbose) {
+    mexPrintf("Loading tree at: %s\n", options.ForestName.c_str());
+  }
+
+	DataPointCollection testData = MexTestDataPointCollection(features);  
+
+  if (IsPackedForest(options.ForestName)) {
+    PackedForest<F, GaussianAggregator1d> forest(options.ForestName);
+    regress_function(forest, testData, nlhs, plhs, options);
+    return;
+  }
+
+	std::auto_ptr<Forest<F, GaussianAggregator1d> > forest = LoadForest<F, GaussianAggregator1d>(options.ForestName);
+  regress_function(*forest, testData, nlhs, plhs, options);
+}
+
+// F: Feature Response
+// The classification forest options.ForestName, packed or not.
+template<typename F>
+EnsembleMember* load_member(const Options& options)
+{
+  if (IsPackedForest(options.ForestName)) {
+    return new ForestEnsembleMember<PackedForest<F, HistogramAggregator> >(
+      new PackedForest<F, HistogramAggregator>(options.ForestName), options);
+  }
+
+  return new ForestEnsembleMember<Forest<F, HistogramAggregator> >(
+    LoadForest<F, HistogramAggregator>(options.ForestName).release(), options);
+}
+
+// Inputs: features, a cell array of settings (one per forest, each with
+// its own ForestName, WeakLearner, ...) and optionally the weight of each
+// forest (double, all one by default).
+//
+// Outputs:
+// 0: weighted mean of the class probabilities of the forests (single)
+//    ordered as (class, index)
+// 1: class probabilities of each forest (single) ordered as
+//    (class, forest, index)
+//
+// See ClassifyEnsemble.
+void ensemble_function(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+  DataPointCollection testData = MexTestDataPointCollection(prhs[0]);
+
+  unsigned int num_forests = (unsigned int)mxGetNumberOfElements(prhs[1]);
+  std::vector<double> weights(num_forests, 1.0);
+
+  if (nrhs > 2) {
+    if (!mxIsDouble(prhs[2]) || mxGetNumberOfElements(prhs[2]) != num_forests) {
+      throw std::runtime_error("Expected one weight (double) per forest.");
+    }
+    weights.assign(mxGetPr(prhs[2]), mxGetPr(prhs[2]) + num_forests);
+  }
+
+  std::vector<EnsembleMember*> forests;
+
+  try {
+    for (unsigned int k = 0; k < num_forests; k++)
+    {
+      const mxArray* settings = mxGetCell(prhs[1], k);
+      if (!settings || !mxIsStruct(settings)) {
+        throw std::runtime_error("Expected a cell array of settings.");
+      }
+
+      MexParams params(1, &settings);
+      Options options(params);
+
+      if (options.Task == Regression) {
+        throw std::runtime_error("Ensembles are only supported for classification.");
+      }
+
+      if (options.Verbose) {
+        mexPrintf("Loading tree at: %s\n", options.ForestName.c_str());
+      }
+
+      if (options.WeakLearner == AxisAligned) {
+        forests.push_back(load_member<AxisAlignedFeatureResponse>(options));
+      }
+      else if (options.WeakLearner == RandomHyperplane && !options.FeatureScaling) {
+        forests.push_back(load_member<RandomHyperplaneFeatureResponse>(options));
+      }
+      else if (options.WeakLearner == RandomHyperplane && options.FeatureScaling) {
+        forests.push_back(load_member<RandomHyperplaneFeatureResponseNormalized>(options));
+      }
+    }
+
+    unsigned int num_classes = num_forests > 0 ? forests[0]->ClassCount() : 0;
+    unsigned int num_points = testData.Count();
+
+    matrix<float> output(num_classes, num_points);
+    matrix<float> forestProbabilities(nlhs > 1 ? num_classes : 0, num_forests, nlhs > 1 ? num_points : 0);
+
+    ClassifyEnsemble(forests, weights, testData, output.data, nlhs > 1 ? forestProbabilities.data : 0);
+
+    plhs[0] = output;
+
+    if (nlhs > 1) {
+      plhs[1] = forestProbabilities;
+    }
+  }
+  catch (...) {
+    for (unsigned int k = 0; k < forests.size(); k++) {
+      delete forests[k];
+    }
+    throw;
+  }
+
+  for (unsigned int k = 0; k < forests.size(); k++) {
+    delete forests[k];
+  }
+}
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray  *prhs[])
+{
+  if (nrhs > 1 && mxIsCell(prhs[1])) {
+    ensemble_function(nlhs, plhs, nrhs, prhs);
+    return;
+  }
+
+  MexParams params(1, prhs+1);
+  Options options(params);
+
+  if (options.Task == Regression) {
+    if (options.WeakLearner == AxisAligned) {
+      regression_function<AxisAlignedFeatureResponse>(nlhs, plhs, nrhs, prhs, options);
+    }
+    else if (options.WeakLearner == RandomHyperplane && !options.FeatureScaling) {
+      regression_function<RandomHyperplaneFeatureResponse>(nlhs, plhs, nrhs, prhs, options);
+    }
+    else if (options.WeakLearner == RandomHyperplane && options.FeatureScaling) {
+      regression_function<RandomHyperplaneFeatureResponseNormalized>(nlhs, plhs, nrhs, prhs, options);
+    }
+
+    return;
+  }
+
+  if (options.WeakLearner == AxisAligned) {
+    main_function<AxisAlignedFeatureResponse, HistogramAggregator>(nlhs, plhs, nrhs, prhs, options);
+  }
+  else if (options.WeakLearner == RandomHyperplane && !options.FeatureScaling) {
+    main_function<RandomHyperplaneFeatureResponse, HistogramAggregator>(nlhs, plhs, nrhs, prhs, options);
+  }
+  else if (options.WeakLearner == RandomHyperplane && options.FeatureScaling) {
+    main_function<RandomHyperplaneFeatureResponseNormalized, HistogramAggregator>(nlhs, plhs, nrhs, prhs, options);
+  }
+
+}
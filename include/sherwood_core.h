@@ -0,0 +1,228 @@
+#pragma once
+
+// Training and classification without MATLAB. Nothing in this header or
+// the headers it includes depends on mex.h; sherwood_mex.h adds the MEX
+// adapters on top of it.
+
+#include <cstdio>
+#include <string>
+#include <stdexcept>
+#include <iostream>
+#include <fstream>
+#include <memory>
+
+struct Stats {
+  float mean;
+  float stdev;
+
+  Stats() {
+    mean = 0;
+    stdev = 0;
+  }
+
+  Stats(float mean, float stdev)
+  : mean(mean), stdev(stdev)
+  {}
+
+};
+
+// Verbose output. The MEX files print to the MATLAB command window instead.
+#ifndef SHERWOOD_PRINTF
+#define SHERWOOD_PRINTF printf
+#endif
+
+#include "Sherwood.h"
+#include "ProgressStream.h"
+#include "DataPointCollection.h"
+#include "StatisticsAggregators.h"
+#include "ClassificationContext.h"
+#include "FeatureResponseFunctions.h"
+#include "Serialize.h"
+
+namespace MicrosoftResearch { namespace Cambridge { namespace Sherwood
+{
+
+enum WeakLearnType {AxisAligned, RandomHyperplane};
+enum TreeAggregatorType {Histogram, Probability};
+enum TaskType {Classification, Regression};
+
+// Parameter source returning the default for every key.
+struct DefaultParams
+{
+  template<typename T> T get(const std::string& key, T def)
+  {
+    return def;
+  }
+};
+
+struct Options
+{
+  Options()
+  {
+    DefaultParams params;
+    Init(params);
+  }
+
+  // Params is any class with a member template get<T>(key, default),
+  // e.g. MexParams or CliParams.
+  template<typename Params>
+  Options(Params params)
+  {
+    Init(params);
+  }
+
+  int MaxDecisionLevels;
+  int NumberOfCandidateFeatures;
+  int NumberOfCandidateThresholdsPerFeature;
+  int NumberOfTrees;
+
+  // Number of dimensions, drawn per tree, that the axis-aligned features
+  // of a tree read; 0 for all dimensions. Random hyperplanes read all
+  // dimensions and require 0.
+  int FeaturesPerTree;
+  int MaxThreads;
+
+  // Seed of the random numbers of training, 0 for a seed from the time.
+  // Tree t is the same for the same seed, whatever the number of threads.
+  int Seed;
+
+  bool FeatureScaling;
+  bool Verbose;
+
+  // Train axis-aligned features on a feature-major copy of the training
+  // data: faster, but the features are held twice.
+  bool TransposeFeatures;
+
+  // Train each tree on a bootstrap sample of the training data and
+  // estimate the error on the examples left out (out-of-bag).
+  bool Bootstrap;
+
+  // Anytime classification: stop evaluating trees for an example once the
+  // remaining trees cannot change the most probable class, or its probability
+  // exceeds EarlyExitConfidence after EarlyExitMinTrees trees.
+  bool EarlyExit;
+  double EarlyExitConfidence;
+  int EarlyExitMinTrees;
+  std::string ForestName;
+
+  TreeAggregatorType TreeAggregator;
+  WeakLearnType WeakLearner;
+  TaskType Task;
+
+  // Used for Verbose output
+  std::string TreeAggregatorStr;
+  std::string WeakLearnerStr;
+  std::string TaskStr;
+
+private:
+  template<typename Params>
+  void Init(Params& params)
+  {
+    MaxDecisionLevels = params.template get<int>("MaxDecisionLevels", 5) - 1;
+    NumberOfCandidateFeatures = params.template get<int>("NumberOfCandidateFeatures", 10);
+    NumberOfCandidateThresholdsPerFeature = params.template get<int>("NumberOfCandidateThresholdsPerFeature", 1);
+    MaxThreads = params.template get<int>("MaxThreads", 1);
+    NumberOfTrees = params.template get<int>("NumberOfTrees", 30);
+    FeaturesPerTree = params.template get<int>("FeaturesPerTree", 0);
+    Seed = params.template get<int>("Seed", 0);
+
+    FeatureScaling = params.template get<bool>("FeatureScaling", true);
+    Verbose = params.template get<bool>("Verbose", false);
+    TransposeFeatures = params.template get<bool>("TransposeFeatures", true);
+    Bootstrap = params.template get<bool>("Bootstrap", false);
+
+    EarlyExit = params.template get<bool>("EarlyExit", false);
+    EarlyExitConfidence = params.template get<double>("EarlyExitConfidence", 1.0);
+    EarlyExitMinTrees = params.template get<int>("EarlyExitMinTrees", 1);
+
+    ForestName = params.template get<std::string>("ForestName", "forest.bin");
+
+    WeakLearnerStr = params.template get<std::string>("WeakLearner", "axis-aligned-hyperplane");
+    TreeAggregatorStr = params.template get<std::string>("TreeAggregator", "histogram");
+    TaskStr = params.template get<std::string>("Task", "classification");
+
+    if (WeakLearnerStr == "axis-aligned-hyperplane") {
+      WeakLearner = AxisAligned;
+    } else if (WeakLearnerStr == "random-hyperplane") {
+      WeakLearner = RandomHyperplane;
+    } else {
+      throw std::runtime_error("Unkown WeakLearner");
+    }
+
+    if (TreeAggregatorStr == "histogram") {
+      TreeAggregator = Histogram;
+    } else if (TreeAggregatorStr == "probability") {
+      TreeAggregator = Probability;
+    } else {
+      throw std::runtime_error("Unkown TreeAggregator");
+    }
+
+    if (TaskStr == "classification") {
+      Task = Classification;
+    } else if (TaskStr == "regression") {
+      Task = Regression;
+    } else {
+      throw std::runtime_error("Unkown Task");
+    }
+
+    if (FeaturesPerTree < 0) {
+      throw std::runtime_error("FeaturesPerTree must be >= 0");
+    }
+
+    if (FeaturesPerTree != 0 && WeakLearner != AxisAligned) {
+      throw std::runtime_error("FeaturesPerTree requires the axis-aligned-hyperplane WeakLearner");
+    }
+
+    if (WeakLearner == AxisAligned) {
+      FeatureScaling = false;
+
+      if (Verbose) {
+        SHERWOOD_PRINTF("Turning of feature scaling since it make no difference for axis-aligned-hyperplane weak learner.");
+      }
+    }
+  }
+};
+
+
+std::ostream& operator<<(std::ostream &out, const Options& o)
+{
+    out << " Training parameters:" <<std::endl;
+    out << " Task: (Default: classification): " << o.TaskStr << std::endl;
+    out << " WeakLearner: (Default: axis-aligned-hyperplane): " << o.WeakLearner << std::endl;
+    out << " MaxDecisionLevels (Max Tree depth, default: 5): "
+              << o.MaxDecisionLevels +1 << std::endl;
+    out << " NumberOfTrees: (Default: 30): "
+              << o.NumberOfTrees << std::endl;
+    out  << " NumberOfCandidateFeatures (No. of candidate feature response functions per split node, default: 10): "
+      <<   o.NumberOfCandidateFeatures << std::endl;
+    out << " NumberOfCandidateThresholdsPerFeature (No. of candidate thresholds per feature response function default: 1): "
+    <<  o.NumberOfCandidateThresholdsPerFeature << std::endl;
+    out << " FeaturesPerTree (No. of dimensions drawn for each axis-aligned tree, 0 for all, default: 0): "
+    <<  o.FeaturesPerTree << std::endl;
+    out << " MaxThreads (Default: 1): " << o.MaxThreads << std::endl;
+    out << " Bootstrap (Default: false): " << o.Bootstrap << std::endl;
+    out << " TransposeFeatures (Default: true): " << o.TransposeFeatures << std::endl;
+    out << " Seed (Default: 0): " << o.Seed << std::endl;
+    if (o.TreeAggregator == Histogram) {
+      out << " TreeAggregator: Histogram" << std::endl;
+    } else {
+      out << " TreeAggregator: Probability" << std::endl;
+    }
+
+    return out;
+}
+
+// Reads a forest serialized by Forest::Serialize.
+template<typename F, typename S>
+std::auto_ptr<Forest<F,S> > LoadForest(const std::string& filename)
+{
+  std::ifstream istream(filename.c_str(), std::ios_base::binary);
+
+  if (!istream) {
+    throw std::runtime_error("Could not open forest " + filename);
+  }
+
+  return Forest<F,S>::Deserialize(istream);
+}
+
+}}}
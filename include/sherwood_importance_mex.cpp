@@ -0,0 +1,66 @@
+#include "sherwood_mex.h"
+#include "feature_importance.h"
+
+using namespace MicrosoftResearch::Cambridge::Sherwood;
+
+// F: Feature Response
+// S: StatisticsAggregator
+//
+// Inputs: features (single), labels (uint8, uint16 or uint32, zero based)
+// or targets (single), settings.
+//
+// Outputs:
+// 0: permutation importance (double) for each feature
+// 1: error (misclassification rate or mean squared error) without permutation
+template<typename F, typename S>
+void main_function(int nlhs, mxArray *plhs[], const mxArray *prhs[], const Options& options)
+{
+  const matrix<float> features = prhs[0];
+  DataPointCollection data = MexDataPointCollection(features, prhs[1]);
+
+  std::auto_ptr<Forest<F, S> > forest = LoadForest<F, S>(options.ForestName);
+
+  double baselineError;
+  std::vector<double> importance = PermutationImportance(*forest, data, options, baselineError);
+
+  plhs[0] = MexRowVector(importance);
+
+  if (nlhs > 1) {
+    plhs[1] = mxCreateDoubleScalar(baselineError);
+  }
+}
+
+template<typename S>
+void main_function(int nlhs, mxArray *plhs[], const mxArray *prhs[], const Options& options)
+{
+  if (options.WeakLearner == AxisAligned) {
+    main_function<AxisAlignedFeatureResponse, S>(nlhs, plhs, prhs, options);
+  }
+  else if (options.WeakLearner == RandomHyperplane && !options.FeatureScaling) {
+    main_function<RandomHyperplaneFeatureResponse, S>(nlhs, plhs, prhs, options);
+  }
+  else if (options.WeakLearner == RandomHyperplane && options.FeatureScaling) {
+    main_function<RandomHyperplaneFeatureResponseNormalized, S>(nlhs, plhs, prhs, options);
+  }
+}
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray  *prhs[])
+{
+  MexParams params(1, prhs+2);
+  Options options(params);
+
+  if (options.Task == Regression) {
+    if (mxGetClassID(prhs[1]) != mxSINGLE_CLASS) {
+      mexErrMsgTxt("Regression targets must be single.");
+    }
+
+    main_function<GaussianAggregator1d>(nlhs, plhs, prhs, options);
+  }
+  else {
+    if (mxGetClassID(prhs[1]) == mxSINGLE_CLASS) {
+      mexErrMsgTxt("Classification labels must be uint8, uint16 or uint32.");
+    }
+
+    main_function<HistogramAggregator>(nlhs, plhs, prhs, options);
+  }
+}
@@ -0,0 +1,63 @@
+#include "sherwood_mex.h"
+#include "inspect_forest.h"
+
+using namespace MicrosoftResearch::Cambridge::Sherwood;
+
+// F: Feature Response
+// S: StatisticsAggregator
+//
+// Output: struct with the fields of ForestSummary, counts as uint32 and
+// FeatureUsage and Bytes as double. DepthHistogram is ordered as
+// (depth, tree) with depth 0 (the root) in the first row.
+template<typename F, typename S>
+void main_function(int nlhs, mxArray *plhs[], const Options& options)
+{
+  std::auto_ptr<Forest<F, S> > forest = LoadForest<F, S>(options.ForestName);
+
+  ForestSummary summary = SummarizeForest(*forest);
+
+  const char* fields[] = {"TreeCount", "NodeCount", "LeafCount", "Depth", "Bytes", "DepthHistogram",
+    "LeafTree", "LeafNode", "LeafSamples", "FeatureUsage"};
+
+  mxArray* s = mxCreateStructMatrix(1, 1, sizeof(fields) / sizeof(fields[0]), fields);
+
+  mxSetField(s, 0, "TreeCount", mxCreateDoubleScalar(summary.TreeCount));
+  mxSetField(s, 0, "NodeCount", MexRowVector(summary.NodeCount));
+  mxSetField(s, 0, "LeafCount", MexRowVector(summary.LeafCount));
+  mxSetField(s, 0, "Depth", MexRowVector(summary.Depth));
+  mxSetField(s, 0, "Bytes", MexRowVector(summary.Bytes));
+  mxSetField(s, 0, "DepthHistogram", MexRowVector(summary.DepthHistogram, summary.Levels));
+  mxSetField(s, 0, "LeafTree", MexRowVector(summary.LeafTree));
+  mxSetField(s, 0, "LeafNode", MexRowVector(summary.LeafNode));
+  mxSetField(s, 0, "LeafSamples", MexRowVector(summary.LeafSamples));
+  mxSetField(s, 0, "FeatureUsage", MexRowVector(summary.FeatureUsage));
+
+  plhs[0] = s;
+}
+
+template<typename S>
+void main_function(int nlhs, mxArray *plhs[], const Options& options)
+{
+  if (options.WeakLearner == AxisAligned) {
+    main_function<AxisAlignedFeatureResponse, S>(nlhs, plhs, options);
+  }
+  else if (options.WeakLearner == RandomHyperplane && !options.FeatureScaling) {
+    main_function<RandomHyperplaneFeatureResponse, S>(nlhs, plhs, options);
+  }
+  else if (options.WeakLearner == RandomHyperplane && options.FeatureScaling) {
+    main_function<RandomHyperplaneFeatureResponseNormalized, S>(nlhs, plhs, options);
+  }
+}
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray  *prhs[])
+{
+  MexParams params(1, prhs);
+  Options options(params);
+
+  if (options.Task == Regression) {
+    main_function<GaussianAggregator1d>(nlhs, plhs, options);
+  }
+  else {
+    main_function<HistogramAggregator>(nlhs, plhs, options);
+  }
+}
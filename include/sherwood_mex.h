@@ -1,120 +1,137 @@
-#pragma once
-
-struct Stats {
-  float mean;
-  float stdev;
-
-  Stats() {
-    mean = 0;
-    stdev = 0;    
-  }
-
-  Stats(float mean, float stdev) 
-  : mean(mean), stdev(stdev)
-  {}
-
-};
-
-#include "mex.h"
-#include "mexutils.h"
-#include "cppmatrix.h" 
-#include "Sherwood.h"
-#include "ProgressStream.h"
-#include "DataPointCollection.h"
-#include "StatisticsAggregators.h"
-#include "ClassificationContext.h"
-#include "FeatureResponseFunctions.h"
-#include "Serialize.h"
-#include <iostream>
-
-namespace MicrosoftResearch { namespace Cambridge { namespace Sherwood
-{
-
-enum WeakLearnType {AxisAligned, RandomHyperplane};
-enum TreeAggregatorType {Histogram, Probability};
-
-struct Options
-{
-  Options(MexParams params) 
-  {
-    MaxDecisionLevels = params.get<int>("MaxDecisionLevels", 5) - 1;
-    NumberOfCandidateFeatures = params.get<int>("NumberOfCandidateFeatures", 10);
-    NumberOfCandidateThresholdsPerFeature = params.get<int>("NumberOfCandidateThresholdsPerFeature", 1);
-    MaxThreads = params.get<int>("MaxThreads", 1);
-    NumberOfTrees = params.get<int>("NumberOfTrees", 30);
-
-    FeatureScaling = params.get<bool>("FeatureScaling", true);
-    Verbose = params.get<bool>("Verbose", false);
-
-    ForestName = params.get<string>("ForestName", "forest.bin");  
-
-    WeakLearnerStr = params.get<string>("WeakLearner", "axis-aligned-hyperplane"); 
-    TreeAggregatorStr = params.get<string>("TreeAggregator", "histogram");
-
-    if (WeakLearnerStr == "axis-aligned-hyperplane") {
-      WeakLearner = AxisAligned;
-    } else if (WeakLearnerStr == "random-hyperplane") {
-      WeakLearner = RandomHyperplane;
-    } else {
-      mexErrMsgTxt("Unkown WeakLearner");
-    }
-
-    if (TreeAggregatorStr == "histogram") {
-      TreeAggregator = Histogram;
-    } else if (TreeAggregatorStr == "probability") {
-      TreeAggregator = Probability;
-    } else {
-      mexErrMsgTxt("Unkown TreeAggregator");
-    }
-
-    if (WeakLearner == AxisAligned) {
-      FeatureScaling = false;
-
-      if (Verbose) {
-        mexPrintf("Turning of feature scaling since it make no difference for axis-aligned-hyperplane weak learner.");
-      }
-    }
-  };
-
-  int MaxDecisionLevels;
-  int NumberOfCandidateFeatures;
-  int NumberOfCandidateThresholdsPerFeature;
-  int NumberOfTrees;
-  int MaxThreads;
-
-  bool FeatureScaling;
-  bool Verbose;
-  string ForestName;
-
-  TreeAggregatorType TreeAggregator;
-  WeakLearnType WeakLearner;
-
-  // Used for Verbose output
-  string TreeAggregatorStr;
-  string WeakLearnerStr;
-};
-  
-
-std::ostream& operator<<(std::ostream &out, const Options& o)
-{
-    out << " Training parameters:" <<std::endl;
-    out << " WeakLearner: (Default: axis-aligned-hyperplane): " << o.WeakLearner << std::endl;
-    out << " MaxDecisionLevels (Max Tree depth, default: 5): " 
-              << o.MaxDecisionLevels +1 << std::endl;
-    out << " NumberOfTrees: (Default: 30): " 
-              << o.NumberOfTrees << std::endl;
-    out  << " NumberOfCandidateFeatures (No. of candidate feature response functions per split node, default: 10): " 
-      <<   o.NumberOfCandidateFeatures << std::endl;
-    out << " NumberOfCandidateThresholdsPerFeature (No. of candidate thresholds per feature response function default: 1): " 
-    <<  o.NumberOfCandidateThresholdsPerFeature << std::endl;
-    out << " MaxThreads (Default: 1): " << o.MaxThreads << std::endl;
-    if (o.TreeAggregator == Histogram) {
-      out << " TreeAggregator: Histogram" << std::endl; 
-    } else {
-      out << " TreeAggregator: Probability" << std::endl;
-    }
-
-    return out;
-}
-
-}}}
\ No newline at end of file
+#pragma once
+
+#include "mex.h"
+#include "mexutils.h"
+#include "cppmatrix.h" 
+
+// Verbose output of the library goes to the MATLAB command window.
+#define SHERWOOD_PRINTF mexPrintf
+
+#include "sherwood_core.h"
+#include "TrainingOperation.h"
+#include <iostream>
+
+namespace MicrosoftResearch { namespace Cambridge { namespace Sherwood
+{
+
+// MATLAB features (single, features along rows and examples along columns)
+// and optionally labels (uint8, uint16 or uint32) or targets (single). 
+// No data is copied.
+DataPointCollection MexDataPointCollection(const matrix<float>& features, const mxArray* labelArray = 0)
+{
+  if (labelArray == 0) {
+    return DataPointCollection(features.data, features.M, features.N);
+  }
+
+  ASSERT(mxGetNumberOfElements(labelArray) == features.N);
+
+  switch (mxGetClassID(labelArray)) {
+    case mxUINT8_CLASS:  
+      return DataPointCollection(features.data, features.M, features.N, mxGetData(labelArray), DataPointCollection::UInt8Labels);
+    case mxUINT16_CLASS: 
+      return DataPointCollection(features.data, features.M, features.N, mxGetData(labelArray), DataPointCollection::UInt16Labels);
+    case mxUINT32_CLASS: 
+      return DataPointCollection(features.data, features.M, features.N, mxGetData(labelArray), DataPointCollection::UInt32Labels);
+    case mxSINGLE_CLASS:
+      return DataPointCollection(features.data, features.M, features.N, (const float*)mxGetData(labelArray));
+    default:
+      throw std::runtime_error("Labels must be uint8, uint16 or uint32 and targets single.");
+  }
+}
+
+// Data points to classify, features may be single, double, uint8 or
+// uint16. They are read in place and converted to float per block.
+DataPointCollection MexTestDataPointCollection(const mxArray* features)
+{
+  if (mxIsSparse(features) || mxIsComplex(features)) {
+    throw std::runtime_error("Features must be real and full.");
+  }
+
+  DataPointCollection::FeatureType featureType;
+
+  switch (mxGetClassID(features)) {
+    case mxSINGLE_CLASS: featureType = DataPointCollection::SingleFeatures; break;
+    case mxDOUBLE_CLASS: featureType = DataPointCollection::DoubleFeatures; break;
+    case mxUINT8_CLASS:  featureType = DataPointCollection::UInt8Features; break;
+    case mxUINT16_CLASS: featureType = DataPointCollection::UInt16Features; break;
+    default:
+      throw std::runtime_error("Features must be single, double, uint8 or uint16.");
+  }
+
+  return DataPointCollection(mxGetData(features), featureType,
+                             (unsigned int)mxGetM(features), (unsigned int)mxGetN(features));
+}
+
+// The values as a matrix with M rows, by default a row vector.
+template<typename T>
+mxArray* MexRowVector(const std::vector<T>& values, unsigned int M = 1)
+{
+  matrix<T> array(M, M > 0 ? (int)(values.size() / M) : 0);
+  std::copy(values.begin(), values.end(), array.data);
+  return array;
+}
+
+// The training statistics as a MATLAB struct with the same field names.
+mxArray* MexTrainingStatistics(const TrainingStatistics& statistics)
+{
+  const char* fields[] = {"NumberOfTrees", "TreesTrained", "TotalSeconds", "SecondsRemaining",
+    "PeakMemoryBytes", "TreeSeconds", "LevelSeconds", "LevelNodes", "LevelSplits",
+    "NodesSplit", "Leaves", "CandidateFeatures", "GainEvaluations", "ResponseEvaluations",
+    "ResponseSeconds", "GainSeconds", "PartitionSeconds", "GainImportance",
+    "OutOfBagError", "OutOfBagExamples", "ConfusionMatrix"};
+
+  mxArray* s = mxCreateStructMatrix(1, 1, sizeof(fields) / sizeof(fields[0]), fields);
+
+  mxSetField(s, 0, "NumberOfTrees", mxCreateDoubleScalar(statistics.NumberOfTrees));
+  mxSetField(s, 0, "TreesTrained", mxCreateDoubleScalar(statistics.TreesTrained));
+  mxSetField(s, 0, "TotalSeconds", mxCreateDoubleScalar(statistics.TotalSeconds));
+  mxSetField(s, 0, "SecondsRemaining", mxCreateDoubleScalar(statistics.SecondsRemaining()));
+  mxSetField(s, 0, "PeakMemoryBytes", mxCreateDoubleScalar(statistics.PeakMemoryBytes));
+  mxSetField(s, 0, "TreeSeconds", MexRowVector(statistics.TreeSeconds));
+  mxSetField(s, 0, "LevelSeconds", MexRowVector(statistics.LevelSeconds));
+  mxSetField(s, 0, "LevelNodes", MexRowVector(statistics.LevelNodes));
+  mxSetField(s, 0, "LevelSplits", MexRowVector(statistics.LevelSplits));
+  mxSetField(s, 0, "NodesSplit", mxCreateDoubleScalar(statistics.NodesSplit));
+  mxSetField(s, 0, "Leaves", mxCreateDoubleScalar(statistics.Leaves));
+  mxSetField(s, 0, "CandidateFeatures", mxCreateDoubleScalar(statistics.CandidateFeatures));
+  mxSetField(s, 0, "GainEvaluations", mxCreateDoubleScalar(statistics.GainEvaluations));
+  mxSetField(s, 0, "ResponseEvaluations", mxCreateDoubleScalar(statistics.ResponseEvaluations));
+  mxSetField(s, 0, "ResponseSeconds", mxCreateDoubleScalar(statistics.ResponseSeconds));
+  mxSetField(s, 0, "GainSeconds", mxCreateDoubleScalar(statistics.GainSeconds));
+  mxSetField(s, 0, "PartitionSeconds", mxCreateDoubleScalar(statistics.PartitionSeconds));
+  mxSetField(s, 0, "GainImportance", MexRowVector(statistics.GainImportance));
+  mxSetField(s, 0, "OutOfBagError", mxCreateDoubleScalar(statistics.OutOfBagError));
+  mxSetField(s, 0, "OutOfBagExamples", mxCreateDoubleScalar(statistics.OutOfBagExamples));
+  mxSetField(s, 0, "ConfusionMatrix", MexRowVector(statistics.ConfusionMatrix, statistics.NumberOfClasses));
+
+  return s;
+}
+
+// Calls a MATLAB function handle with the statistics struct. Errors in
+// the function are turned into warnings, so that training continues.
+class MexTrainingProgress : public ITrainingProgress
+{
+public:
+  MexTrainingProgress(const mxArray* function)
+  : function(function)
+  {}
+
+  void TreesTrained(const TrainingStatistics& statistics)
+  {
+    mxArray* prhs[2] = {const_cast<mxArray*>(function), MexTrainingStatistics(statistics)};
+    mxArray* exception = mexCallMATLABWithTrap(0, 0, 2, prhs, "feval");
+    mxDestroyArray(prhs[1]);
+
+    if (exception) {
+      mexWarnMsgTxt("ProgressFcn failed.");
+      mxDestroyArray(exception);
+    }
+
+    flush_output();
+  }
+
+private:
+  const mxArray* function;
+};
+
+}}}
@@ -0,0 +1,51 @@
+#include "sherwood_mex.h"
+#include "packed_forest.h"
+
+using namespace MicrosoftResearch::Cambridge::Sherwood;
+
+// F: Feature Response
+// S: StatisticsAggregator
+//
+// Inputs: settings and the file name of the packed forest.
+template<typename F, typename S>
+void main_function(const Options& options, const std::string& packedName)
+{
+  std::auto_ptr<Forest<F, S> > forest = LoadForest<F, S>(options.ForestName);
+  PackForest(*forest, packedName);
+}
+
+template<typename S>
+void main_function(const Options& options, const std::string& packedName)
+{
+  if (options.WeakLearner == AxisAligned) {
+    main_function<AxisAlignedFeatureResponse, S>(options, packedName);
+  }
+  else if (options.WeakLearner == RandomHyperplane && !options.FeatureScaling) {
+    main_function<RandomHyperplaneFeatureResponse, S>(options, packedName);
+  }
+  else if (options.WeakLearner == RandomHyperplane && options.FeatureScaling) {
+    main_function<RandomHyperplaneFeatureResponseNormalized, S>(options, packedName);
+  }
+}
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray  *prhs[])
+{
+  if (nrhs != 2) {
+    mexErrMsgTxt("Expected settings and the name of the packed forest.");
+  }
+
+  MexParams params(1, prhs);
+  Options options(params);
+
+  char buffer[1024];
+  if (!mxIsChar(prhs[1]) || mxGetString(prhs[1], buffer, 1024)) {
+    mexErrMsgTxt("The name of the packed forest must be a string.");
+  }
+
+  if (options.Task == Regression) {
+    main_function<GaussianAggregator1d>(options, buffer);
+  }
+  else {
+    main_function<HistogramAggregator>(options, buffer);
+  }
+}
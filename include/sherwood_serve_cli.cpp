@@ -0,0 +1,560 @@
+// Classification server on a Unix domain socket, for scoring without
+// loading the forests for every request.
+//
+// sherwood-serve socket forest [forest ...] [Key=Value ...]
+//
+// The keys are the same as SherwoodSettings and must match the settings
+// used for training; all forests are of the same WeakLearner and Task.
+// Clients connect to the socket and send any number of requests, each
+// answered in order on the same connection. All values are native
+// (little endian) uint32 or float32:
+//
+//   request:  forest index (zero based, in the order given above),
+//             dimensions, count, count*dimensions features
+//   response: status (0), outputs, count, count*outputs values
+//             (class probabilities, or the predicted target and its
+//             variance), or on error status (1), 0, length and length
+//             bytes of message.
+//
+// Requests that are complete when the server wakes up are evaluated
+// together, one batch per forest and number of dimensions, in parallel
+// with MaxThreads threads. Answers are sent without blocking, so a client
+// that does not read its answers does not hold up the others; it is not
+// read from while too many of its answers are unsent. The server stops on
+// SIGINT or SIGTERM.
+#include "sherwood_core.h"
+#include "classify_forest.h"
+#include "cliutils.h"
+
+#include <signal.h>
+#include <poll.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <string.h>
+
+#if USE_OPENMP == 1
+#include <omp.h>
+#endif
+
+using namespace MicrosoftResearch::Cambridge::Sherwood;
+
+namespace {
+
+// Larger requests, or requests of more examples, are refused and their
+// connection closed.
+const size_t MaxRequestBytes = (size_t)1 << 30;
+const unsigned int MaxRequestExamples = 1u << 24;
+
+// Requests to the same forest are evaluated in batches of at most this
+// many examples.
+const size_t MaxBatchExamples = (size_t)1 << 26;
+
+// Clients with more unsent answers are not read from until these are sent.
+const size_t MaxPendingBytes = (size_t)1 << 26;
+
+volatile sig_atomic_t stopRequested = 0;
+
+void stop(int)
+{
+  stopRequested = 1;
+}
+
+struct Client
+{
+  int socket;
+  // Received bytes not yet part of a complete request.
+  std::vector<char> buffer;
+  // Answers not yet sent.
+  std::vector<char> pending;
+};
+
+struct Request
+{
+  Client* client;
+  unsigned int forest;
+  unsigned int dimensions;
+  unsigned int count;
+  const float* features;
+
+  // Outputs per example and the outputs, or the error.
+  unsigned int outputs;
+  std::vector<float> values;
+  std::string error;
+};
+
+void append(std::vector<char>& pending, const void* data, size_t bytes)
+{
+  const char* p = (const char*)data;
+  pending.insert(pending.end(), p, p + bytes);
+}
+
+void queue_response(const Request& request)
+{
+  std::vector<char>& pending = request.client->pending;
+  unsigned int header[3];
+
+  if (!request.error.empty()) {
+    header[0] = 1;
+    header[1] = 0;
+    header[2] = (unsigned int)request.error.size();
+    append(pending, header, sizeof(header));
+    append(pending, request.error.data(), request.error.size());
+    return;
+  }
+
+  header[0] = 0;
+  header[1] = request.outputs;
+  header[2] = request.count;
+  append(pending, header, sizeof(header));
+  append(pending, request.values.empty() ? 0 : &request.values[0], request.values.size() * sizeof(float));
+}
+
+// Sends as much of the pending answers of client as its socket takes
+// without blocking. Returns false if the connection failed.
+bool flush(Client& client)
+{
+  size_t sent = 0;
+
+  while (sent < client.pending.size())
+  {
+    ssize_t bytes = send(client.socket, &client.pending[sent], client.pending.size() - sent, 0);
+    if (bytes < 0 && errno == EINTR) {
+      continue;
+    }
+    if (bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      break;
+    }
+    if (bytes <= 0) {
+      return false;
+    }
+
+    sent += bytes;
+  }
+
+  client.pending.erase(client.pending.begin(), client.pending.begin() + sent);
+  return true;
+}
+
+// Number of dimensions the split nodes of the forest read.
+template<typename F, typename S>
+unsigned int ForestDimensions(const Forest<F,S>& forest)
+{
+  std::vector<double> usage;
+
+  for (int t = 0; t < (int)forest.TreeCount(); t++)
+  {
+    const Tree<F,S>& tree = forest.GetTree(t);
+
+    for (int n = 0; n < tree.NodeCount(); n++) {
+      if (tree.GetNode(n).IsSplit()) {
+        AddFeatureUsage(tree.GetNode(n).Feature, 1.0, usage);
+      }
+    }
+  }
+
+  return (unsigned int)usage.size();
+}
+
+// Class probabilities ordered as (class, index), evaluated in blocks of
+// ClassifyBlockSize in parallel.
+template<typename F>
+unsigned int Evaluate(Forest<F, HistogramAggregator>& forest, const DataPointCollection& data,
+                      const Options& options, std::vector<float>& output)
+{
+  unsigned int num_classes = CountClasses(forest);
+  int num_blocks = (int)((data.Count() + ClassifyBlockSize - 1) / ClassifyBlockSize);
+
+  output.assign((size_t)num_classes * data.Count(), 0.0f);
+
+  #pragma omp parallel for schedule(dynamic)
+  for (int b = 0; b < num_blocks; b++)
+  {
+    unsigned int first = b * ClassifyBlockSize;
+    unsigned int count = std::min(ClassifyBlockSize, data.Count() - first);
+
+    ClassificationOutputs out;
+    out.probabilities = &output[(size_t)first * num_classes];
+    ClassifyForest(forest, DataPointCollection(data, first, count), options, out);
+  }
+
+  return num_classes;
+}
+
+// Predicted target and variance ordered as (output, index).
+template<typename F>
+unsigned int Evaluate(Forest<F, GaussianAggregator1d>& forest, const DataPointCollection& data,
+                      const Options& options, std::vector<float>& output)
+{
+  int num_blocks = (int)((data.Count() + ClassifyBlockSize - 1) / ClassifyBlockSize);
+
+  output.assign(2 * (size_t)data.Count(), 0.0f);
+
+  #pragma omp parallel
+  {
+    std::vector<float> mean, variance;
+
+    #pragma omp for schedule(dynamic)
+    for (int b = 0; b < num_blocks; b++)
+    {
+      unsigned int first = b * ClassifyBlockSize;
+      unsigned int count = std::min(ClassifyBlockSize, data.Count() - first);
+
+      mean.assign(count, 0.0f);
+      variance.assign(count, 0.0f);
+
+      RegressionOutputs out;
+      out.mean = &mean[0];
+      out.variance = &variance[0];
+      RegressForest(forest, DataPointCollection(data, first, count), options, out);
+
+      for (unsigned int i = 0; i < count; i++) {
+        output[2*((size_t)first + i)] = mean[i];
+        output[2*((size_t)first + i) + 1] = variance[i];
+      }
+    }
+  }
+
+  return 2;
+}
+
+// Moves the complete requests in the buffer of client to requests. Returns
+// false if the client sent a request too large to accept.
+bool parse_requests(Client& client, std::vector<Request>& requests, std::vector<size_t>& consumed)
+{
+  size_t offset = 0;
+  const size_t headerBytes = 3 * sizeof(unsigned int);
+
+  while (client.buffer.size() - offset >= headerBytes)
+  {
+    unsigned int header[3];
+    memcpy(header, &client.buffer[offset], headerBytes);
+
+    size_t featureBytes = (size_t)header[1] * header[2] * sizeof(float);
+    if (header[1] != 0 && featureBytes / header[1] != (size_t)header[2] * sizeof(float)) {
+      return false;
+    }
+    if (featureBytes > MaxRequestBytes || header[2] > MaxRequestExamples) {
+      return false;
+    }
+
+    if (client.buffer.size() - offset - headerBytes < featureBytes) {
+      break;
+    }
+
+    Request request;
+    request.client = &client;
+    request.forest = header[0];
+    request.dimensions = header[1];
+    request.count = header[2];
+    request.features = (const float*)&client.buffer[offset + headerBytes];
+    request.outputs = 0;
+    requests.push_back(request);
+
+    offset += headerBytes + featureBytes;
+  }
+
+  consumed.push_back(offset);
+  return true;
+}
+
+template<typename F, typename S>
+void serve(const std::string& socketName, const std::vector<std::string>& forestNames, const Options& options)
+{
+  std::vector<Forest<F,S>*> forests;
+  std::vector<unsigned int> forestDimensions;
+
+  for (size_t f = 0; f < forestNames.size(); f++)
+  {
+    forests.push_back(LoadForest<F,S>(forestNames[f]).release());
+    forestDimensions.push_back(ForestDimensions(*forests.back()));
+
+    if (forests.back()->TreeCount() == 0) {
+      throw std::runtime_error("No trees in " + forestNames[f]);
+    }
+  }
+
+  #if USE_OPENMP == 1
+    omp_set_num_threads(std::max(options.MaxThreads, 1));
+  #endif
+
+  sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+
+  if (socketName.size() >= sizeof(address.sun_path)) {
+    throw std::runtime_error("Socket name too long: " + socketName);
+  }
+  strcpy(address.sun_path, socketName.c_str());
+
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0) {
+    throw std::runtime_error(std::string("Could not create a socket: ") + strerror(errno));
+  }
+
+  // Replace the socket of an earlier server, but no other file.
+  struct stat existing;
+  if (lstat(socketName.c_str(), &existing) == 0)
+  {
+    if (!S_ISSOCK(existing.st_mode)) {
+      close(listener);
+      throw std::runtime_error("Could not listen on " + socketName + ": path exists and is not a socket");
+    }
+    unlink(socketName.c_str());
+  }
+
+  if (bind(listener, (sockaddr*)&address, sizeof(address)) != 0 || listen(listener, SOMAXCONN) != 0) {
+    throw std::runtime_error("Could not listen on " + socketName + ": " + strerror(errno));
+  }
+
+  signal(SIGPIPE, SIG_IGN);
+  signal(SIGINT, stop);
+  signal(SIGTERM, stop);
+
+  if (options.Verbose) {
+    fprintf(stderr, "Serving %u forests on %s\n", (unsigned int)forests.size(), socketName.c_str());
+  }
+
+  std::vector<Client*> clients;
+  std::vector<pollfd> fds;
+  std::vector<char> received(1 << 16);
+
+  std::vector<float> batchFeatures;
+  std::vector<float> batchOutput;
+
+  while (!stopRequested)
+  {
+    fds.resize(clients.size() + 1);
+    fds[0].fd = listener;
+    fds[0].events = POLLIN;
+    for (size_t c = 0; c < clients.size(); c++) {
+      fds[c + 1].fd = clients[c]->socket;
+      fds[c + 1].events = clients[c]->pending.size() < MaxPendingBytes ? POLLIN : 0;
+      if (!clients[c]->pending.empty()) {
+        fds[c + 1].events |= POLLOUT;
+      }
+    }
+
+    if (poll(&fds[0], fds.size(), -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::runtime_error(std::string("poll failed: ") + strerror(errno));
+    }
+
+    // Send pending answers and receive what is available; clients that
+    // closed, failed or sent an invalid request are closed.
+    std::vector<Request> requests;
+    std::vector<size_t> consumed;
+
+    for (size_t c = 0; c < clients.size(); c++)
+    {
+      Client* client = clients[c];
+      short revents = fds[c + 1].revents;
+      bool keep = true;
+
+      if (!client->pending.empty() && (revents & (POLLOUT | POLLHUP | POLLERR))) {
+        keep = flush(*client);
+      }
+
+      if (keep && (fds[c + 1].events & POLLIN) && (revents & (POLLIN | POLLHUP | POLLERR)))
+      {
+        ssize_t bytes = recv(client->socket, &received[0], received.size(), 0);
+
+        if (bytes > 0) {
+          client->buffer.insert(client->buffer.end(), received.begin(), received.begin() + bytes);
+        } else if (bytes == 0 || (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK)) {
+          keep = false;
+        }
+      }
+
+      if (keep) {
+        keep = parse_requests(*client, requests, consumed);
+      }
+
+      if (!keep) {
+        consumed.push_back(0);
+        close(client->socket);
+        client->socket = -1;
+      }
+    }
+
+    for (size_t r = 0; r < requests.size(); r++)
+    {
+      Request& request = requests[r];
+
+      if (request.client->socket < 0) {
+        request.error = "closed";
+      } else if (request.forest >= forests.size()) {
+        request.error = "Invalid forest index";
+      } else if (request.dimensions < forestDimensions[request.forest]) {
+        std::stringstream sout;
+        sout << "The forest needs " << forestDimensions[request.forest] << " dimensions, got " << request.dimensions;
+        request.error = sout.str();
+      }
+    }
+
+    // One batch per forest and number of dimensions, split where it
+    // would exceed MaxBatchExamples.
+    std::vector<bool> done(requests.size(), false);
+
+    for (size_t r = 0; r < requests.size(); r++)
+    {
+      if (done[r] || !requests[r].error.empty())
+        continue;
+
+      unsigned int forest = requests[r].forest;
+      unsigned int dimensions = requests[r].dimensions;
+
+      std::vector<size_t> batch;
+      size_t count = 0;
+
+      for (size_t q = r; q < requests.size(); q++)
+      {
+        if (!done[q] && requests[q].error.empty() &&
+            requests[q].forest == forest && requests[q].dimensions == dimensions &&
+            (batch.empty() || count + requests[q].count <= MaxBatchExamples))
+        {
+          batch.push_back(q);
+          count += requests[q].count;
+          done[q] = true;
+        }
+      }
+
+      batchFeatures.resize(count * dimensions);
+      size_t first = 0;
+      for (size_t k = 0; k < batch.size(); k++)
+      {
+        const Request& request = requests[batch[k]];
+        std::copy(request.features, request.features + (size_t)request.count * dimensions,
+                  batchFeatures.begin() + first * dimensions);
+        first += request.count;
+      }
+
+      if (count == 0) {
+        continue;
+      }
+
+      DataPointCollection data(&batchFeatures[0], dimensions, (unsigned int)count);
+      unsigned int outputs = Evaluate(*forests[forest], data, options, batchOutput);
+
+      first = 0;
+      for (size_t k = 0; k < batch.size(); k++)
+      {
+        Request& request = requests[batch[k]];
+        request.outputs = outputs;
+        request.values.assign(batchOutput.begin() + first * outputs,
+                              batchOutput.begin() + (first + request.count) * outputs);
+        first += request.count;
+      }
+
+      if (options.Verbose) {
+        fprintf(stderr, "Forest %u: %u requests, %u examples\n", forest, (unsigned int)batch.size(), (unsigned int)count);
+      }
+    }
+
+    // Answer in the order received, send what the sockets take and drop
+    // the answered requests from the buffers.
+    for (size_t r = 0; r < requests.size(); r++) {
+      if (requests[r].client->socket >= 0) {
+        queue_response(requests[r]);
+      }
+    }
+
+    std::vector<Client*> open;
+
+    for (size_t c = 0; c < clients.size(); c++)
+    {
+      Client* client = clients[c];
+
+      if (client->socket >= 0 && !flush(*client)) {
+        close(client->socket);
+        client->socket = -1;
+      }
+
+      if (client->socket < 0) {
+        delete client;
+      } else {
+        client->buffer.erase(client->buffer.begin(), client->buffer.begin() + consumed[c]);
+        open.push_back(client);
+      }
+    }
+
+    clients = open;
+
+    if (fds[0].revents & POLLIN)
+    {
+      int connection = accept(listener, 0, 0);
+      if (connection >= 0) {
+        fcntl(connection, F_SETFL, fcntl(connection, F_GETFL) | O_NONBLOCK);
+        clients.push_back(new Client());
+        clients.back()->socket = connection;
+      }
+    }
+  }
+
+  for (size_t c = 0; c < clients.size(); c++) {
+    close(clients[c]->socket);
+    delete clients[c];
+  }
+
+  for (size_t f = 0; f < forests.size(); f++) {
+    delete forests[f];
+  }
+
+  close(listener);
+  unlink(socketName.c_str());
+}
+
+template<typename F>
+void run(const std::string& socketName, const std::vector<std::string>& forestNames, const Options& options)
+{
+  if (options.Task == Regression) {
+    serve<F, GaussianAggregator1d>(socketName, forestNames, options);
+  } else {
+    serve<F, HistogramAggregator>(socketName, forestNames, options);
+  }
+}
+
+}
+
+int main(int argc, char** argv)
+{
+  // The forests are the arguments before the first Key=Value.
+  int numForests = 0;
+  while (2 + numForests < argc && strchr(argv[2 + numForests], '=') == 0) {
+    numForests++;
+  }
+
+  if (numForests == 0) {
+    fprintf(stderr, "Usage: %s socket forest [forest ...] [Key=Value ...]\n", argv[0]);
+    return 1;
+  }
+
+  try {
+    CliParams params(argc - 2 - numForests, argv + 2 + numForests);
+    Options options(params);
+
+    std::vector<std::string> forestNames(argv + 2, argv + 2 + numForests);
+    options.ForestName = forestNames[0];
+
+    if (options.WeakLearner == AxisAligned) {
+      run<AxisAlignedFeatureResponse>(argv[1], forestNames, options);
+    }
+    else if (options.WeakLearner == RandomHyperplane && !options.FeatureScaling) {
+      run<RandomHyperplaneFeatureResponse>(argv[1], forestNames, options);
+    }
+    else if (options.WeakLearner == RandomHyperplane && options.FeatureScaling) {
+      run<RandomHyperplaneFeatureResponseNormalized>(argv[1], forestNames, options);
+    }
+  }
+  catch (std::exception& e) {
+    fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,100 @@
+#include "sherwood_mex.h"
+#include "sweep_forest.h"
+
+using namespace MicrosoftResearch::Cambridge::Sherwood;
+
+// F: Feature Response
+// S: StatisticsAggregator
+//
+// Inputs: features (single), labels (uint8, uint16 or uint32, zero based)
+// or targets (single), settings, cell array of settings (one per
+// configuration) and optionally validation features and labels.
+//
+// Outputs:
+// 0: validation (or out-of-bag) error of each configuration (double)
+// 1: training time of each configuration in seconds (double)
+template<typename F, typename S>
+void main_function(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[],
+                   const Options& options, const std::vector<Options>& configurations)
+{
+  const matrix<float> features = prhs[0];
+  DataPointCollection trainingData = MexDataPointCollection(features, prhs[1]);
+
+  std::auto_ptr<matrix<float> > validationFeatures;
+  std::auto_ptr<DataPointCollection> validationData;
+
+  if (nrhs > 5) {
+    validationFeatures.reset(new matrix<float>(prhs[4]));
+    ASSERT(validationFeatures->M == features.M);
+    validationData.reset(new DataPointCollection(MexDataPointCollection(*validationFeatures, prhs[5])));
+  }
+
+  std::vector<SweepResult> results = SweepForests<F, S>(trainingData, validationData.get(), options, configurations);
+
+  std::vector<double> errors, seconds;
+  for (unsigned int c = 0; c < results.size(); c++) {
+    errors.push_back(results[c].Error);
+    seconds.push_back(results[c].Seconds);
+  }
+
+  plhs[0] = MexRowVector(errors);
+
+  if (nlhs > 1) {
+    plhs[1] = MexRowVector(seconds);
+  }
+}
+
+template<typename S>
+void main_function(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[],
+                   const Options& options, const std::vector<Options>& configurations)
+{
+  if (options.WeakLearner == AxisAligned) {
+    main_function<AxisAlignedFeatureResponse, S>(nlhs, plhs, nrhs, prhs, options, configurations);
+  }
+  else if (options.WeakLearner == RandomHyperplane && !options.FeatureScaling) {
+    main_function<RandomHyperplaneFeatureResponse, S>(nlhs, plhs, nrhs, prhs, options, configurations);
+  }
+  else if (options.WeakLearner == RandomHyperplane && options.FeatureScaling) {
+    main_function<RandomHyperplaneFeatureResponseNormalized, S>(nlhs, plhs, nrhs, prhs, options, configurations);
+  }
+}
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray  *prhs[])
+{
+  if (nrhs != 4 && nrhs != 6) {
+    mexErrMsgTxt("Expected features, labels, settings, configurations and optionally validation features and labels.");
+  }
+
+  MexParams params(1, prhs+2);
+  Options options(params);
+
+  if (!mxIsCell(prhs[3])) {
+    mexErrMsgTxt("Configurations must be a cell array of settings.");
+  }
+
+  // The weak learner and task select the code, they cannot vary.
+  std::vector<Options> configurations;
+  for (unsigned int c = 0; c < mxGetNumberOfElements(prhs[3]); c++)
+  {
+    const mxArray* settings = mxGetCell(prhs[3], c);
+    MexParams configurationParams(1, &settings);
+    configurations.push_back(Options(configurationParams));
+
+    if (configurations.back().WeakLearner != options.WeakLearner ||
+        configurations.back().FeatureScaling != options.FeatureScaling ||
+        configurations.back().Task != options.Task) {
+      mexErrMsgTxt("WeakLearner, FeatureScaling and Task must be the same for all configurations.");
+    }
+  }
+
+  if ((mxGetClassID(prhs[1]) == mxSINGLE_CLASS) != (options.Task == Regression)) {
+    mexErrMsgTxt("Classification labels must be uint8, uint16 or uint32 and regression targets single.");
+  }
+
+  if (options.Task == Regression) {
+    main_function<GaussianAggregator1d>(nlhs, plhs, nrhs, prhs, options, configurations);
+  }
+  else {
+    main_function<HistogramAggregator>(nlhs, plhs, nrhs, prhs, options, configurations);
+  }
+}
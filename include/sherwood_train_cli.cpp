@@ -0,0 +1,62 @@
+// Command line training, see cliutils.h for the file formats.
+//
+// sherwood-train features labels forest [Key=Value ...]
+//
+// The keys are the same as SherwoodSettings, e.g. Task=regression
+// NumberOfTrees=100. Dimensions is needed for binary feature files.
+// Labels are 0, ..., n-1 (classification) or the targets (regression).
+#include "sherwood_core.h"
+#include "train_forest.h"
+#include "cliutils.h"
+
+using namespace MicrosoftResearch::Cambridge::Sherwood;
+
+int main(int argc, char** argv)
+{
+  if (argc < 4) {
+    fprintf(stderr, "Usage: %s features labels forest [Key=Value ...]\n", argv[0]);
+    return 1;
+  }
+
+  try {
+    CliParams params(argc - 4, argv + 4);
+    Options options(params);
+    options.ForestName = argv[3];
+
+    unsigned int dimensions = params.get<int>("Dimensions", 0);
+    std::vector<float> features;
+    unsigned int numPoints = read_examples(argv[1], dimensions, features);
+
+    unsigned int one = 1;
+    std::vector<unsigned int> labels;
+    std::vector<float> targets;
+
+    if (options.Task == Regression) {
+      if (read_examples(argv[2], one, targets) != numPoints) {
+        throw std::runtime_error("The number of targets and examples differ.");
+      }
+    } else {
+      if (read_examples(argv[2], one, labels) != numPoints) {
+        throw std::runtime_error("The number of labels and examples differ.");
+      }
+    }
+
+    if (numPoints == 0) {
+      throw std::runtime_error("No training data.");
+    }
+
+    if (options.Task == Regression) {
+      DataPointCollection trainingData(&features[0], dimensions, numPoints, &targets[0]);
+      TrainAndSaveForest(trainingData, options);
+    } else {
+      DataPointCollection trainingData(&features[0], dimensions, numPoints, &labels[0], DataPointCollection::UInt32Labels);
+      TrainAndSaveForest(trainingData, options);
+    }
+  }
+  catch (std::exception& e) {
+    fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+
+  return 0;
+}
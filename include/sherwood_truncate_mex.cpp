@@ -0,0 +1,77 @@
+#include "sherwood_mex.h"
+#include "truncate_forest.h"
+
+using namespace MicrosoftResearch::Cambridge::Sherwood;
+
+// F: Feature Response
+// S: StatisticsAggregator
+//
+// Inputs: settings, MaxDecisionLevels of each truncated forest (double)
+// and a cell array with the file name of each truncated forest.
+//
+// The forest settings.ForestName is loaded once.
+template<typename F, typename S>
+void main_function(const Options& options, const std::vector<double>& levels,
+                   const std::vector<std::string>& names)
+{
+  std::auto_ptr<Forest<F, S> > forest = LoadForest<F, S>(options.ForestName);
+
+  for (unsigned int k = 0; k < levels.size(); k++)
+  {
+    std::auto_ptr<Forest<F, S> > truncated = TruncateForest(*forest, (int)levels[k] - 1);
+
+    std::ofstream o(names[k].c_str(), std::ios_base::binary);
+    truncated->Serialize(o);
+  }
+}
+
+template<typename S>
+void main_function(const Options& options, const std::vector<double>& levels,
+                   const std::vector<std::string>& names)
+{
+  if (options.WeakLearner == AxisAligned) {
+    main_function<AxisAlignedFeatureResponse, S>(options, levels, names);
+  }
+  else if (options.WeakLearner == RandomHyperplane && !options.FeatureScaling) {
+    main_function<RandomHyperplaneFeatureResponse, S>(options, levels, names);
+  }
+  else if (options.WeakLearner == RandomHyperplane && options.FeatureScaling) {
+    main_function<RandomHyperplaneFeatureResponseNormalized, S>(options, levels, names);
+  }
+}
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray  *prhs[])
+{
+  if (nrhs != 3) {
+    mexErrMsgTxt("Expected settings, levels and forest names.");
+  }
+
+  MexParams params(1, prhs);
+  Options options(params);
+
+  if (!mxIsDouble(prhs[1]) || !mxIsCell(prhs[2]) ||
+      mxGetNumberOfElements(prhs[1]) != mxGetNumberOfElements(prhs[2])) {
+    mexErrMsgTxt("Expected one forest name per level.");
+  }
+
+  std::vector<double> levels(mxGetPr(prhs[1]), mxGetPr(prhs[1]) + mxGetNumberOfElements(prhs[1]));
+  std::vector<std::string> names;
+
+  for (unsigned int k = 0; k < levels.size(); k++)
+  {
+    char buffer[1024];
+    // A tree has fewer than 32 decision levels (its node count is an int);
+    // the bound keeps the conversion to int defined.
+    if (!(levels[k] >= 1 && levels[k] <= 32) || mxGetString(mxGetCell(prhs[2], k), buffer, 1024)) {
+      mexErrMsgTxt("Levels must be between 1 and 32 and forest names strings.");
+    }
+    names.push_back(buffer);
+  }
+
+  if (options.Task == Regression) {
+    main_function<GaussianAggregator1d>(options, levels, names);
+  }
+  else {
+    main_function<HistogramAggregator>(options, levels, names);
+  }
+}
@@ -0,0 +1,171 @@
+// Training of many forests on the same data for hyperparameter search.
+#pragma once
+
+#include "train_forest.h"
+#include <vector>
+#include <time.h>
+
+#if USE_OPENMP == 1
+#include <omp.h>
+#endif
+
+namespace MicrosoftResearch { namespace Cambridge { namespace Sherwood
+{
+
+// Error (as TrainingStatistics::OutOfBagError) of a configuration and the
+// time spent training its trees.
+struct SweepResult
+{
+  double Error;
+  double Seconds;
+
+  SweepResult()
+  : Error(0), Seconds(0)
+  {}
+};
+
+// Configurations differing only in NumberOfTrees share their trees.
+bool SameTrees(const Options& a, const Options& b)
+{
+  return a.MaxDecisionLevels == b.MaxDecisionLevels &&
+    a.NumberOfCandidateFeatures == b.NumberOfCandidateFeatures &&
+    a.NumberOfCandidateThresholdsPerFeature == b.NumberOfCandidateThresholdsPerFeature &&
+    a.FeaturesPerTree == b.FeaturesPerTree &&
+    a.Bootstrap == b.Bootstrap &&
+    a.TreeAggregator == b.TreeAggregator;
+}
+
+// F: Feature Response
+// S: StatisticsAggregator
+//
+// Trains a forest for each configuration and returns its error on
+// validationData, or the out-of-bag error if validationData is null (the
+// configurations are then trained with Bootstrap). The forests are not
+// saved.
+//
+// The feature statistics are computed once. Configurations that differ
+// only in NumberOfTrees are trained as one forest, evaluated after each
+// of their numbers of trees. These groups are trained in parallel with
+// options.MaxThreads threads, one thread per group.
+template<typename F, typename S>
+std::vector<SweepResult> SweepForests(const DataPointCollection& data,
+                                      const DataPointCollection* validationData,
+                                      const Options& options,
+                                      std::vector<Options> configurations)
+{
+  // As in TrainForest.
+  DataPointCollection trainingData(data);
+  if (F::FeatureMajor() && options.TransposeFeatures) {
+    trainingData.TransposeFeatures();
+  }
+
+  std::vector<Stats> featureStats;
+  if (options.FeatureScaling) {
+    for (unsigned int d = 0; d < trainingData.Dimensions(); ++d) {
+      featureStats.push_back(trainingData.GetStats(d));
+    }
+  }
+
+  FeatureFactory<F> featureFactory(trainingData.Dimensions(), featureStats);
+
+  unsigned int classes = trainingData.HasLabels() ? trainingData.CountClasses() : 0;
+
+  // Groups of configurations with the same trees.
+  std::vector<std::vector<unsigned int> > groups;
+
+  for (unsigned int c = 0; c < configurations.size(); c++)
+  {
+    if (!validationData) {
+      configurations[c].Bootstrap = true;
+    }
+
+    unsigned int g = 0;
+    while (g < groups.size() && !SameTrees(configurations[groups[g][0]], configurations[c])) {
+      g++;
+    }
+
+    if (g == groups.size()) {
+      groups.push_back(std::vector<unsigned int>());
+    }
+
+    groups[g].push_back(c);
+  }
+
+  std::vector<SweepResult> results(configurations.size());
+  unsigned int seed = options.Seed != 0 ? (unsigned int)options.Seed : (unsigned int)time(NULL);
+
+  #if USE_OPENMP == 1
+    omp_set_num_threads(std::max(options.MaxThreads, 1));
+  #endif
+
+  #pragma omp parallel for schedule(dynamic)
+  for (int g = 0; g < (int)groups.size(); g++)
+  {
+    const Options& groupOptions = configurations[groups[g][0]];
+
+    int numberOfTrees = 0;
+    for (unsigned int k = 0; k < groups[g].size(); k++) {
+      numberOfTrees = std::max(numberOfTrees, configurations[groups[g][k]].NumberOfTrees);
+    }
+
+    TrainingParameters trainingParameters;
+    trainingParameters.MaxDecisionLevels = groupOptions.MaxDecisionLevels;
+    trainingParameters.NumberOfCandidateFeatures = groupOptions.NumberOfCandidateFeatures;
+    trainingParameters.NumberOfCandidateThresholdsPerFeature = groupOptions.NumberOfCandidateThresholdsPerFeature;
+    trainingParameters.NumberOfTrees = numberOfTrees;
+    trainingParameters.Verbose = false;
+
+    TrainingContext<F, S> trainingContext(trainingData, &featureFactory);
+
+    const DataPointCollection& evaluationData = validationData ? *validationData : trainingData;
+    OutOfBagVotes<S> votes(evaluationData, groupOptions, classes);
+
+    std::vector<unsigned int> bag, outOfBag, validation;
+    std::vector<int> leaves;
+    TrainingStatistics statistics;
+
+    if (validationData) {
+      for (unsigned int i = 0; i < validationData->Count(); i++) {
+        validation.push_back(i);
+      }
+    }
+
+    // The data points each tree is evaluated on.
+    const std::vector<unsigned int>& evaluated = validationData ? validation : outOfBag;
+
+    double start = WallTime();
+
+    // Trees as trained by TrainForest with options.Seed.
+    for (int t = 0; t < numberOfTrees; t++)
+    {
+      Random random(MixSeed(seed, t));
+
+      if (groupOptions.Bootstrap) {
+        BootstrapSample(random, trainingData.Count(), bag, outOfBag);
+      }
+
+      std::auto_ptr<Tree<F,S> > tree = TrainTree(random, trainingContext.context, trainingParameters,
+          trainingData, statistics, groupOptions.Bootstrap ? &bag : 0,
+          (unsigned int)groupOptions.FeaturesPerTree);
+
+      ApplyOutOfBag(*tree, evaluationData, evaluated, leaves);
+      votes.Add(*tree, evaluated, leaves);
+
+      for (unsigned int k = 0; k < groups[g].size(); k++)
+      {
+        if (configurations[groups[g][k]].NumberOfTrees == t + 1)
+        {
+          TrainingStatistics error;
+          votes.Finish(evaluationData, error);
+
+          results[groups[g][k]].Error = error.OutOfBagError;
+          results[groups[g][k]].Seconds = WallTime() - start;
+        }
+      }
+    }
+  }
+
+  return results;
+}
+
+}}}
@@ -0,0 +1,533 @@
+// Forest training on a DataPointCollection, shared by the MEX file
+// and the command line tool.
+#pragma once
+
+#include "sherwood_core.h"
+#include "TrainingOperation.h"
+#include "classify_forest.h"
+
+#if USE_OPENMP == 1
+#include <omp.h>
+#endif
+
+namespace MicrosoftResearch { namespace Cambridge { namespace Sherwood
+{
+
+template<typename F>
+class FeatureFactory: public IFeatureResponseFactory<F>
+{
+public:
+
+  FeatureFactory(unsigned int dimensions, std::vector<Stats> featureStats)
+  : dimensions(dimensions), featureStats(featureStats)
+  {};
+
+  F CreateRandom(Random& random)
+  {
+    return F::CreateRandom(random, dimensions, featureStats);
+  }
+
+  void CreateRandom(Random& random, F& feature)
+  {
+    F::CreateRandom(random, dimensions, featureStats, feature);
+  }
+private:
+  unsigned int dimensions;
+  std::vector<Stats> featureStats;
+};
+
+// The training context is determined by the statistics aggregator:
+// histograms for classification and Gaussians for regression.
+template<typename F, typename S>
+struct TrainingContext;
+
+template<typename F>
+struct TrainingContext<F, HistogramAggregator>
+{
+  ClassificationTrainingContext<F> context;
+
+  TrainingContext(const DataPointCollection& data, IFeatureResponseFactory<F>* featureFactory)
+  : context(data.CountClasses(), featureFactory)
+  {}
+};
+
+template<typename F>
+struct TrainingContext<F, GaussianAggregator1d>
+{
+  RegressionTrainingContext<F> context;
+
+  TrainingContext(const DataPointCollection& data, IFeatureResponseFactory<F>* featureFactory)
+  : context(featureFactory)
+  {}
+};
+
+// Draws count data points with replacement into bag, the data points not
+// drawn are returned in outOfBag.
+void BootstrapSample(Random& random, unsigned int count,
+                     std::vector<unsigned int>& bag, std::vector<unsigned int>& outOfBag)
+{
+  std::vector<char> inBag(count, 0);
+  bag.resize(count);
+
+  for (unsigned int i = 0; i < count; i++) {
+    bag[i] = std::min(count - 1, (unsigned int)(random.NextDouble() * count));
+    inBag[bag[i]] = 1;
+  }
+
+  outOfBag.clear();
+  for (unsigned int i = 0; i < count; i++) {
+    if (!inBag[i]) {
+      outOfBag.push_back(i);
+    }
+  }
+}
+
+// Predictions of the trees for the data points they were not trained on
+// (or validation data), summed as in ClassifyForest and RegressForest.
+template<typename S>
+class OutOfBagVotes;
+
+template<>
+class OutOfBagVotes<HistogramAggregator>
+{
+public:
+  // The classes of the training data, if not those of data.
+  OutOfBagVotes(const DataPointCollection& data, const Options& options, unsigned int trainingClasses = 0)
+  : classes(trainingClasses > 0 ? trainingClasses : data.CountClasses()), histogram(options.TreeAggregator == Histogram),
+    votes((size_t)classes * data.Count(), 0.0f), trees(data.Count(), 0)
+  {}
+
+  // leaves are the leaf node indices of the data points in outOfBag.
+  template<typename F>
+  void Add(const Tree<F, HistogramAggregator>& tree, const std::vector<unsigned int>& outOfBag, const std::vector<int>& leaves)
+  {
+    for (size_t k = 0; k < outOfBag.size(); k++)
+    {
+      unsigned int i = outOfBag[k];
+      const HistogramAggregator& aggregator = tree.GetNode(leaves[k]).TrainingDataStatistics;
+
+      if (histogram) {
+        aggregator.AccumulateCounts(&votes[(size_t)i*classes]);
+      } else {
+        aggregator.AccumulateProbabilities(&votes[(size_t)i*classes]);
+      }
+
+      trees[i]++;
+    }
+  }
+
+  void Finish(const DataPointCollection& data, TrainingStatistics& statistics)
+  {
+    statistics.NumberOfClasses = classes;
+    statistics.ConfusionMatrix.assign((size_t)classes * classes, 0.0);
+
+    double errors = 0;
+    statistics.OutOfBagExamples = 0;
+
+    for (unsigned int i = 0; i < data.Count(); i++)
+    {
+      if (trees[i] == 0)
+        continue;
+
+      const float* P = &votes[(size_t)i*classes];
+      unsigned int predicted = (unsigned int)(std::max_element(P, P + classes) - P);
+      unsigned int label = data.GetIntegerLabel(i);
+
+      // Labels of validation data may not be present in the training data.
+      if (label < classes) {
+        statistics.ConfusionMatrix[label + (size_t)classes*predicted] += 1;
+      }
+
+      statistics.OutOfBagExamples++;
+
+      if (predicted != label) {
+        errors++;
+      }
+    }
+
+    statistics.OutOfBagError = statistics.OutOfBagExamples > 0 ? errors / statistics.OutOfBagExamples : 0;
+  }
+
+private:
+  unsigned int classes;
+  bool histogram;
+  std::vector<float> votes;
+  std::vector<unsigned int> trees;
+};
+
+template<>
+class OutOfBagVotes<GaussianAggregator1d>
+{
+public:
+  OutOfBagVotes(const DataPointCollection& data, const Options& options, unsigned int classes = 0)
+  : sum(data.Count(), 0.0), trees(data.Count(), 0)
+  {}
+
+  template<typename F>
+  void Add(const Tree<F, GaussianAggregator1d>& tree, const std::vector<unsigned int>& outOfBag, const std::vector<int>& leaves)
+  {
+    for (size_t k = 0; k < outOfBag.size(); k++)
+    {
+      sum[outOfBag[k]] += tree.GetNode(leaves[k]).TrainingDataStatistics.Mean();
+      trees[outOfBag[k]]++;
+    }
+  }
+
+  void Finish(const DataPointCollection& data, TrainingStatistics& statistics)
+  {
+    double errors = 0;
+    statistics.OutOfBagExamples = 0;
+
+    for (unsigned int i = 0; i < data.Count(); i++)
+    {
+      if (trees[i] == 0)
+        continue;
+
+      double e = sum[i] / trees[i] - data.GetTarget(i);
+      errors += e * e;
+      statistics.OutOfBagExamples++;
+    }
+
+    statistics.OutOfBagError = statistics.OutOfBagExamples > 0 ? errors / statistics.OutOfBagExamples : 0;
+  }
+
+private:
+  std::vector<double> sum;
+  std::vector<unsigned int> trees;
+};
+
+// Leaf node indices of the data points in outOfBag.
+template<typename F, typename S>
+void ApplyOutOfBag(const Tree<F,S>& tree, const DataPointCollection& data,
+                   const std::vector<unsigned int>& outOfBag, std::vector<int>& leaves)
+{
+  leaves.resize(outOfBag.size());
+
+  for (size_t k = 0; k < outOfBag.size(); k++) {
+    leaves[k] = ApplyDataPoint(tree, data, outOfBag[k]);
+  }
+}
+
+// Sets the totals of the statistics and reports them.
+void ReportProgress(TrainingStatistics& statistics, double start, ITrainingProgress* progress)
+{
+  statistics.TotalSeconds = WallTime() - start;
+  statistics.PeakMemoryBytes = PeakMemoryBytes();
+
+  if (progress) {
+    progress->TreesTrained(statistics);
+  }
+}
+
+// F: Feature Response
+// S: StatisticsAggregator
+//
+// If not null, statistics receives the counters and timers of training
+// and progress is called as trees are finished.
+template<typename F, typename S>
+std::auto_ptr<Forest<F,S> > TrainForest(const DataPointCollection& data, Options options,
+                                        TrainingStatistics* statistics = 0, ITrainingProgress* progress = 0)
+{
+  double start = WallTime();
+
+  // Nodes read their data points over and over; for features reading one
+  // dimension a feature-major copy turns these reads into contiguous ones.
+  // Without the copy (TransposeFeatures false) they read the features in
+  // place.
+  DataPointCollection trainingData(data);
+  if (F::FeatureMajor() && options.TransposeFeatures) {
+    trainingData.TransposeFeatures();
+  }
+
+  TrainingStatistics localStatistics;
+  if (!statistics) {
+    statistics = &localStatistics;
+  }
+  *statistics = TrainingStatistics();
+  statistics->NumberOfTrees = options.NumberOfTrees;
+
+  PrintTrainingProgress printProgress;
+  if (!progress && options.Verbose) {
+    progress = &printProgress;
+  }
+
+  // Supervised classification
+  TrainingParameters trainingParameters;
+  trainingParameters.MaxDecisionLevels = options.MaxDecisionLevels;
+  trainingParameters.NumberOfCandidateFeatures = options.NumberOfCandidateFeatures;
+  trainingParameters.NumberOfCandidateThresholdsPerFeature = options.NumberOfCandidateThresholdsPerFeature;
+  trainingParameters.NumberOfTrees = options.NumberOfTrees;
+  trainingParameters.Verbose = false;
+
+	if (options.Verbose) {
+    if (trainingData.HasTargetValues()) {
+		  SHERWOOD_PRINTF("Training data has: %d features and %d examples with target values.\n",
+                trainingData.Dimensions(), trainingData.Count());
+    } else {
+		  SHERWOOD_PRINTF("Training data has: %d features %d classes and %d examples.\n",
+                trainingData.Dimensions(), trainingData.CountClasses(), trainingData.Count());
+    }
+
+    SHERWOOD_PRINTF("Using WeakLearner: %s. \n", options.WeakLearnerStr.c_str());
+  }
+
+  // Tree t draws its random numbers from a Random seeded by seed and t.
+  unsigned int seed = options.Seed != 0 ? (unsigned int)options.Seed : (unsigned int)time(NULL);
+
+  // The range for each feature
+  std::vector<Stats> featureStats;
+  featureStats.reserve(trainingData.Dimensions());
+
+  if (!options.FeatureScaling) {
+
+    if (options.Verbose && options.WeakLearner != AxisAligned) {
+      SHERWOOD_PRINTF("No feature scaling is performed: make sure your features are scaled. \n");
+    }
+
+  } else {
+    for (unsigned int d = 0; d < trainingData.Dimensions(); ++d) {
+      featureStats.push_back(trainingData.GetStats(d));
+
+      if (options.Verbose) {
+        SHERWOOD_PRINTF("Feature: %d mean: %f stdev: %f. \n", d, featureStats[d].mean, featureStats[d].stdev);
+      }
+    }
+  }
+
+  FeatureFactory<F> featureFactory(trainingData.Dimensions(), featureStats);
+
+  unsigned int featuresPerTree = (unsigned int)options.FeaturesPerTree;
+
+	TrainingContext<F, S> trainingContext(trainingData, &featureFactory);
+
+  // Without OPENMP no multi threading.
+  #if USE_OPENMP == 0
+    if (options.MaxThreads > 1) {
+      SHERWOOD_PRINTF("Compiled without OpenMP flags, falling back to single thread code.\n");
+    }
+
+    options.MaxThreads = 1;
+  #endif
+
+  std::auto_ptr<Forest<F, S> > forest ;
+
+  std::auto_ptr<OutOfBagVotes<S> > outOfBagVotes;
+  if (options.Bootstrap) {
+    outOfBagVotes.reset(new OutOfBagVotes<S>(trainingData, options));
+  }
+
+	// Create forest
+  if (options.MaxThreads == 1)
+  {
+    if (options.Verbose) {
+      SHERWOOD_PRINTF("Using 1 thread.\n");
+    }
+
+    // ForestTrainer.h
+    forest = std::auto_ptr<Forest<F,S> >(new Forest<F,S>());
+
+    std::vector<unsigned int> bag, outOfBag;
+    std::vector<int> leaves;
+
+    for (int t = 0; t < trainingParameters.NumberOfTrees; t++)
+    {
+      Random random(MixSeed(seed, t));
+
+      if (options.Bootstrap) {
+        BootstrapSample(random, trainingData.Count(), bag, outOfBag);
+      }
+
+      std::auto_ptr<Tree<F,S> > tree = TrainTree(random, trainingContext.context, trainingParameters,
+          trainingData, *statistics, options.Bootstrap ? &bag : 0, featuresPerTree);
+
+      if (options.Bootstrap) {
+        ApplyOutOfBag(*tree, trainingData, outOfBag, leaves);
+        outOfBagVotes->Add(*tree, outOfBag, leaves);
+      }
+
+      forest->AddTree(tree);
+      ReportProgress(*statistics, start, progress);
+    }
+  }
+
+  // Parallel
+  // ParallelForestTrainer.h segfaults using gcc.
+  else
+  {
+    #if USE_OPENMP == 1
+      omp_set_num_threads(options.MaxThreads);
+
+      if (options.Verbose)
+      {
+        int current_num_threads;
+
+        #pragma omp parallel
+          current_num_threads = omp_get_num_threads();
+
+        SHERWOOD_PRINTF("Using OpenMP with %d threads (maximum %d) \n", current_num_threads, omp_get_max_threads());
+      }
+
+      forest = std::auto_ptr<Forest<F,S> >(new Forest<F,S>());
+
+      omp_lock_t writelock;
+      omp_init_lock(&writelock);
+
+      // Trees finished by the other threads are reported by the master
+      // thread, as MATLAB can only be called from it. It reports a copy of
+      // the statistics taken under the lock, so that a slow progress
+      // callback does not hold up the threads finishing trees.
+      unsigned int reported = 0;
+      volatile int finished = 0;
+
+      // The trees are added to the forest in order, so that a forest
+      // depends only on the seed and not on the number of threads.
+      std::vector<Tree<F,S>*> trees(trainingParameters.NumberOfTrees, (Tree<F,S>*)0);
+
+      #pragma omp parallel
+      {
+        #pragma omp for schedule(dynamic, 1) nowait
+        for (int t = 0; t < trainingParameters.NumberOfTrees; t++)
+        {
+          std::vector<unsigned int> bag, outOfBag;
+          std::vector<int> leaves;
+
+          Random random(MixSeed(seed, t));
+
+          if (options.Bootstrap) {
+            BootstrapSample(random, trainingData.Count(), bag, outOfBag);
+          }
+
+          TrainingStatistics treeStatistics;
+          std::auto_ptr<Tree<F,S> > tree = TrainTree(random,
+              trainingContext.context, trainingParameters, trainingData, treeStatistics,
+              options.Bootstrap ? &bag : 0, featuresPerTree);
+
+          // The out-of-bag data points are evaluated while the tree is in
+          // cache, only the votes are added under the lock.
+          if (options.Bootstrap) {
+            ApplyOutOfBag(*tree, trainingData, outOfBag, leaves);
+          }
+
+          omp_set_lock(&writelock);
+          if (options.Bootstrap) {
+            outOfBagVotes->Add(*tree, outOfBag, leaves);
+          }
+
+          trees[t] = tree.release();
+          statistics->Merge(treeStatistics);
+          finished = finished + 1;
+          #pragma omp flush
+
+          TrainingStatistics snapshot;
+          bool report = omp_get_thread_num() == 0;
+          if (report) {
+            snapshot = *statistics;
+            reported = snapshot.TreesTrained;
+          }
+          omp_unset_lock(&writelock);
+
+          if (report) {
+            ReportProgress(snapshot, start, progress);
+          }
+        }
+
+        // Once out of trees, the master thread reports the trees the other
+        // threads are still training as they are finished. The count of
+        // finished trees is polled without the lock.
+        if (omp_get_thread_num() == 0)
+        {
+          for (;;)
+          {
+            #pragma omp flush
+            int trained = finished;
+
+            if ((unsigned int)trained > reported)
+            {
+              omp_set_lock(&writelock);
+              TrainingStatistics snapshot = *statistics;
+              reported = snapshot.TreesTrained;
+              omp_unset_lock(&writelock);
+
+              ReportProgress(snapshot, start, progress);
+            }
+
+            if (trained == trainingParameters.NumberOfTrees) {
+              break;
+            }
+
+            SleepSeconds(0.1);
+          }
+        }
+      }
+
+      omp_destroy_lock(&writelock);
+
+      for (int t = 0; t < trainingParameters.NumberOfTrees; t++) {
+        forest->AddTree(std::auto_ptr<Tree<F,S> >(trees[t]));
+      }
+
+    #endif
+  }
+
+  statistics->TotalSeconds = WallTime() - start;
+  statistics->PeakMemoryBytes = PeakMemoryBytes();
+  statistics->GainImportance.resize(trainingData.Dimensions(), 0.0);
+
+  if (options.Bootstrap) {
+    outOfBagVotes->Finish(trainingData, *statistics);
+  }
+
+  if (options.Verbose) {
+    PrintTrainingStatistics(*statistics);
+  }
+
+  return forest;
+}
+
+template<typename F, typename S>
+void TrainAndSaveForest(const DataPointCollection& trainingData, const Options& options,
+                        TrainingStatistics* statistics, ITrainingProgress* progress)
+{
+  std::auto_ptr<Forest<F, S> > forest = TrainForest<F, S>(trainingData, options, statistics, progress);
+
+  // Saving the forest
+  std::ofstream o(options.ForestName.c_str(), std::ios_base::binary);
+	forest->Serialize(o);
+}
+
+template<typename S>
+void TrainAndSaveForest(const DataPointCollection& trainingData, const Options& options,
+                        TrainingStatistics* statistics, ITrainingProgress* progress)
+{
+  if (options.WeakLearner == AxisAligned) {
+    TrainAndSaveForest<AxisAlignedFeatureResponse, S>(trainingData, options, statistics, progress);
+  }
+  else if (options.WeakLearner == RandomHyperplane && !options.FeatureScaling) {
+    TrainAndSaveForest<RandomHyperplaneFeatureResponse, S>(trainingData, options, statistics, progress);
+  }
+  else if (options.WeakLearner == RandomHyperplane && options.FeatureScaling) {
+    TrainAndSaveForest<RandomHyperplaneFeatureResponseNormalized, S>(trainingData, options, statistics, progress);
+  }
+}
+
+// Trains a forest for options.Task and saves it to options.ForestName.
+void TrainAndSaveForest(const DataPointCollection& trainingData, const Options& options,
+                        TrainingStatistics* statistics = 0, ITrainingProgress* progress = 0)
+{
+  if (options.Task == Regression) {
+    if (!trainingData.HasTargetValues()) {
+      throw std::runtime_error("Regression needs target values.");
+    }
+
+    TrainAndSaveForest<GaussianAggregator1d>(trainingData, options, statistics, progress);
+  }
+  else {
+    if (!trainingData.HasLabels()) {
+      throw std::runtime_error("Classification needs integer labels.");
+    }
+
+    TrainAndSaveForest<HistogramAggregator>(trainingData, options, statistics, progress);
+  }
+}
+
+}}}
@@ -0,0 +1,62 @@
+// Shallower forests from a trained forest.
+#pragma once
+
+#include "sherwood_core.h"
+#include <algorithm>
+
+namespace MicrosoftResearch { namespace Cambridge { namespace Sherwood
+{
+
+// The tree with split nodes at depth levels (the root has depth 0) made
+// leaves, using the statistics of the training data kept in every node.
+// This is the tree that training with levels decision levels (that is
+// MaxDecisionLevels levels + 1) and the same seed would give. Trees with
+// at most levels decision levels are copied.
+template<typename F, typename S>
+std::auto_ptr<Tree<F,S> > TruncateTree(const Tree<F,S>& tree, int levels)
+{
+  // A tree with d decision levels has 2^(d+1)-1 nodes; levels is clamped
+  // to those of tree before any shift.
+  int treeLevels = 0;
+  while (((size_t)2 << (treeLevels + 1)) - 1 <= (size_t)tree.NodeCount()) {
+    treeLevels++;
+  }
+
+  levels = std::max(0, std::min(levels, treeLevels));
+
+  std::auto_ptr<Tree<F,S> > truncated(new Tree<F,S>(levels));
+
+  int nodeCount = truncated->NodeCount();
+  int firstLeaf = (truncated->NodeCount() - 1) / 2;
+
+  for (int n = 0; n < nodeCount; n++)
+  {
+    const Node<F,S>& node = tree.GetNode(n);
+
+    if (node.IsSplit() && n >= firstLeaf) {
+      truncated->GetNode(n).InitializeLeaf(node.TrainingDataStatistics);
+    } else {
+      truncated->GetNode(n) = node;
+    }
+  }
+
+  truncated->CheckValid();
+
+  return truncated;
+}
+
+// F: Feature Response
+// S: StatisticsAggregator
+template<typename F, typename S>
+std::auto_ptr<Forest<F,S> > TruncateForest(const Forest<F,S>& forest, int levels)
+{
+  std::auto_ptr<Forest<F,S> > truncated(new Forest<F,S>());
+
+  for (int t = 0; t < forest.TreeCount(); t++) {
+    truncated->AddTree(TruncateTree(forest.GetTree(t), levels));
+  }
+
+  return truncated;
+}
+
+}}}
@@ -1,115 +1,143 @@
-% MATLAB wrapper for the c++ wrapper.
-function [P, bins] = sherwood_classify(features, settings)
-
-if (~isa(settings, 'SherwoodSettings'))
-	error('Second argument must be SherwoodSettings class');
-end
-
-my_path = fileparts(mfilename('fullpath'));
-addpath([my_path filesep 'include']);
-
-% Convert
-features = single(features);
-
-my_name = mfilename('fullpath');
-my_path = fileparts(my_name);
-cpp_file = 'sherwood_classify_mex.cpp';
-[~,out_file] = fileparts(cpp_file);
-out_file = ['include' filesep out_file];
-
-% Includes etc
-extra_arguments = {};
-extra_arguments{end+1} = ['-I' my_path];
-extra_arguments{end+1} = ['-I' my_path filesep 'include'];
-extra_arguments{end+1} = ['-I' my_path filesep 'Sherwood' filesep 'cpp' filesep 'lib'];
-
-% Additional files to be compiled.
-sources = {};
-
-% Only compile if files have changed
-compile_script(cpp_file, out_file, sources, extra_arguments);
-
-% Matlab decided to break backwords compability, this is a workaround to
-% make the code both backward and forward compatibile.
-old_style = false;
-
-v = version('-release');
-year = str2double(v(1:4));
-
-if (year < 2014)
-    old_style = true;
-end
-
-if (strcmp(year,'2013b'))
-    old_style = false;
-end
-
-
-% Parallel
-if (old_style)
-	 poolSize = matlabpool('size'); %#ok<DPOOL>
-else
-    p = gcp;
-    poolSize = p.NumWorkers;
-end
-
-isOpen = poolSize > 0;
-
-if ((settings.MaxThreads) > 1)
-	if (isOpen)
-		if (poolSize ~= settings.MaxThreads)
-			warning('Number of open matlabpool(s) %d while MaxThreads %d, running code with %d threads  \n', poolSize, settings.MaxThreads, poolSize);
-		end
-    else
-        if (old_style)
-            matlabpool(settings.MaxThreads); %#ok<DPOOL>
-        else
-            parpool(settings.MaxThreads);
-        end
-	end
-	
-	sub_bins = cell(settings.MaxThreads,1);
-	index_cut = round(linspace(0,size(features,2), settings.MaxThreads+1));
-	indices = [index_cut(1:end-1)+1; index_cut(2:end)]';
-	 
-	% Matlab cannot assign to bins inside the parfor
-	parfor thread = 1:settings.MaxThreads
-		index = indices(thread,1):indices(thread,2); %#ok<PFBNS>
-		sub_bins{thread} = sherwood_classify_mex(features(:,index), settings.generate_struct); %#ok<PFBNS>
-	end
-	
-	if nargout == 1
-		
-		% Memory efficency.
-		P = zeros( size(sub_bins{1},1),0,'single');	
-		for thread = 1:settings.MaxThreads
-			index = indices(thread,1):indices(thread,2);
-			P(:,index) = sub_bins{thread};
-			sub_bins{thread} = {};
-		end
-	
-		clear sub_bins;
-
-	else
-		bins = [sub_bins{:}];
-		clear sub_bins;
-		P = single(bins);
-	end
-		
-	
-% Single thread
-else
-	if nargout == 1
-		P = single(sherwood_classify_mex(features, settings.generate_struct));
-	else
-		bins = sherwood_classify_mex(features, settings.generate_struct);
-		P = single(bins);
-	end
-	
-end
-
-denom = sum(P,1);
-for i = 1:size(P,1)
-	P(i,:) = single(P(i,:))./denom;
-end
-
+% MATLAB wrapper for the c++ wrapper.
+%
+% Classification: P(c,i) is the probability of class c for example i (single)
+% and bins(c,i) the summed histogram (uint32) or summed probability
+% (single) over the trees.
+% Regression: P(i) is the predicted target of example i and bins(i) the
+% predictive variance (single).
+%
+% Optional outputs, computed in the same pass over the trees:
+% leaves(t,i) is the (zero based) leaf node index example i reaches in tree t (uint32).
+% tree_probabilities(c,t,i) is the probability of class c in tree t (single).
+% For regression tree_probabilities(t,i) is the prediction of tree t.
+% trees_evaluated(i) is the number of trees evaluated for example i (uint32),
+% less than NumberOfTrees only with settings.EarlyExit.
+function [P, bins, leaves, tree_probabilities, trees_evaluated] = sherwood_classify(features, settings)
+
+if (~isa(settings, 'SherwoodSettings'))
+	error('Second argument must be SherwoodSettings class');
+end
+
+my_path = fileparts(mfilename('fullpath'));
+addpath([my_path filesep 'include']);
+
+if issparse(features)
+	features = full(features);
+end
+
+% single, double, uint8 and uint16 features are classified without a
+% converted copy; other classes are converted to single.
+if ~(isa(features,'single') || isa(features,'double') || ...
+     isa(features,'uint8') || isa(features,'uint16'))
+	features = single(features);
+end
+
+my_name = mfilename('fullpath');
+my_path = fileparts(my_name);
+cpp_file = 'sherwood_classify_mex.cpp';
+[~,out_file] = fileparts(cpp_file);
+out_file = ['include' filesep out_file];
+
+% Includes etc
+extra_arguments = {};
+extra_arguments{end+1} = ['-I' my_path];
+extra_arguments{end+1} = ['-I' my_path filesep 'include'];
+extra_arguments{end+1} = ['-I' my_path filesep 'Sherwood' filesep 'cpp' filesep 'lib'];
+
+% Additional files to be compiled.
+sources = {};
+
+% Only compile if files have changed
+compile_script(cpp_file, out_file, sources, extra_arguments);
+
+% Matlab decided to break backwords compability, this is a workaround to
+% make the code both backward and forward compatibile.
+old_style = false;
+
+v = version('-release');
+year = str2double(v(1:4));
+
+if (year < 2014)
+    old_style = true;
+end
+
+if (strcmp(year,'2013b'))
+    old_style = false;
+end
+
+
+% Parallel
+if (old_style)
+	 poolSize = matlabpool('size'); %#ok<DPOOL>
+else
+    p = gcp;
+    poolSize = p.NumWorkers;
+end
+
+isOpen = poolSize > 0;
+
+% The mex file returns the outputs of this function, P is normalized
+% in the mex file.
+num_mex_outputs = max(1, nargout);
+
+if ((settings.MaxThreads) > 1)
+	if (isOpen)
+		if (poolSize ~= settings.MaxThreads)
+			warning('Number of open matlabpool(s) %d while MaxThreads %d, running code with %d threads  \n', poolSize, settings.MaxThreads, poolSize);
+		end
+    else
+        if (old_style)
+            matlabpool(settings.MaxThreads); %#ok<DPOOL>
+        else
+            parpool(settings.MaxThreads);
+        end
+	end
+	
+	sub_bins = cell(settings.MaxThreads,num_mex_outputs);
+	index_cut = round(linspace(0,size(features,2), settings.MaxThreads+1));
+	indices = [index_cut(1:end-1)+1; index_cut(2:end)]';
+	 
+	% Matlab cannot assign to bins inside the parfor
+	parfor thread = 1:settings.MaxThreads
+		index = indices(thread,1):indices(thread,2); %#ok<PFBNS>
+		thread_outputs = cell(1,num_mex_outputs);
+		[thread_outputs{:}] = sherwood_classify_mex(features(:,index), settings.generate_struct); %#ok<PFBNS>
+		sub_bins(thread,:) = thread_outputs;
+	end
+
+	if nargout > 1
+		bins = [sub_bins{:,2}];
+	end
+
+	if nargout > 2
+		leaves = [sub_bins{:,3}];
+	end
+
+	if nargout > 3
+		if strcmp(settings.Task, 'regression')
+			tree_probabilities = [sub_bins{:,4}];
+		else
+			tree_probabilities = cat(3, sub_bins{:,4});
+		end
+	end
+
+	if nargout > 4
+		trees_evaluated = [sub_bins{:,5}];
+	end
+
+	% Memory efficency.
+	P = zeros( size(sub_bins{1},1),0,'single');	
+	for thread = 1:settings.MaxThreads
+		index = indices(thread,1):indices(thread,2);
+		P(:,index) = sub_bins{thread,1};
+		sub_bins(thread,:) = {[]};
+	end
+
+	clear sub_bins;
+	
+% Single thread
+else
+	mex_outputs = cell(1,5);
+	[mex_outputs{1:num_mex_outputs}] = sherwood_classify_mex(features, settings.generate_struct);
+	[P, bins, leaves, tree_probabilities, trees_evaluated] = mex_outputs{:};
+end
@@ -0,0 +1,59 @@
+% Classification with several forests in one pass over the features.
+%
+% settings is a cell array with the SherwoodSettings of each forest
+% (ForestName, WeakLearner, FeatureScaling, TreeAggregator, ...), the
+% forests may be of different weak learners. weights (default all one)
+% is the weight of each forest, finite and nonnegative with a positive sum.
+%
+% P(c,i) is the weighted mean of the probabilities of class c for example
+% i (single); forest_probabilities(c,k,i) the probability of class c in
+% forest k (single).
+%
+% The features are read once per block of examples, which stays in cache
+% while all forests are evaluated.
+function [P, forest_probabilities] = sherwood_classify_ensemble(features, settings, weights)
+
+if (~iscell(settings) || ~all(cellfun(@(s) isa(s, 'SherwoodSettings'), settings)))
+	error('Second argument must be a cell array of SherwoodSettings');
+end
+
+if (nargin < 3)
+	weights = ones(1, numel(settings));
+end
+
+my_path = fileparts(mfilename('fullpath'));
+addpath([my_path filesep 'include']);
+
+if issparse(features)
+	features = full(features);
+end
+
+% As in sherwood_classify.
+if ~(isa(features,'single') || isa(features,'double') || ...
+     isa(features,'uint8') || isa(features,'uint16'))
+	features = single(features);
+end
+
+cpp_file = 'sherwood_classify_mex.cpp';
+[~,out_file] = fileparts(cpp_file);
+out_file = ['include' filesep out_file];
+
+% Includes etc
+extra_arguments = {};
+extra_arguments{end+1} = ['-I' my_path];
+extra_arguments{end+1} = ['-I' my_path filesep 'include'];
+extra_arguments{end+1} = ['-I' my_path filesep 'Sherwood' filesep 'cpp' filesep 'lib'];
+
+% Additional files to be compiled.
+sources = {};
+
+% Only compile if files have changed
+compile_script(cpp_file, out_file, sources, extra_arguments);
+
+structs = cellfun(@(s) s.generate_struct, settings, 'UniformOutput', false);
+
+if (nargout > 1)
+	[P, forest_probabilities] = sherwood_classify_mex(features, structs, double(weights));
+else
+	P = sherwood_classify_mex(features, structs, double(weights));
+end
@@ -0,0 +1,74 @@
+% Permutation feature importance of the forest settings.ForestName.
+%
+% importance(d) is the increase of the error on (features, labels) when
+% feature d is permuted over the examples, baseline_error the error
+% without permutation. The error is the misclassification rate for
+% classification and the mean squared error for regression (labels are
+% then the targets). The forest is loaded once and settings.MaxThreads
+% threads are used.
+%
+% Gain based importance is returned by sherwood_train
+% (stats.GainImportance).
+function [importance, baseline_error] = sherwood_importance(features, labels, settings)
+
+if (~isa(settings, 'SherwoodSettings'))
+	error('Third argument must be SherwoodSettings class');
+end
+
+% Set to false if the compiler does not support OpenMP, see sherwood_train.m.
+use_openmp = true;
+
+my_path = fileparts(mfilename('fullpath'));
+addpath([my_path filesep 'include']);
+
+if (size(features,2) ~= numel(labels))
+	error('Number of columns in feature vector (number of examples) must be same as length of labels')
+end
+
+features = single(features);
+
+if strcmp(settings.Task, 'regression')
+	labels = single(labels);
+else
+	if (min(labels(:)) < 1)
+		error('Labels ids must start at 1');
+	end
+
+	if ~(isa(labels,'uint8') || isa(labels,'uint16') || isa(labels,'uint32'))
+		labels = uint32(labels);
+	end
+
+	% Labels from 0 in c++ code.
+	labels = labels-1;
+end
+
+cpp_file = 'sherwood_importance_mex.cpp';
+[~,out_file] = fileparts(cpp_file);
+out_file = ['include' filesep out_file];
+
+% Includes etc
+extra_arguments = {};
+extra_arguments{end+1} = ['-I' my_path];
+extra_arguments{end+1} = ['-I' my_path filesep 'include'];
+extra_arguments{end+1} = ['-I' my_path filesep 'Sherwood' filesep 'cpp' filesep 'lib'];
+
+if (use_openmp)
+	if ~ispc
+		extra_arguments{end+1} = '-lgomp';
+		extra_arguments{end+1} = 'CXXFLAGS="\$CXXFLAGS -fopenmp"';
+	else
+		extra_arguments{end+1} = 'COMPFLAGS="$COMPFLAGS /openmp"';
+	end
+
+	extra_arguments{end+1} = '-DUSE_OPENMP=1';
+else
+	extra_arguments{end+1} = '-DUSE_OPENMP=0'; %#ok<UNRCH>
+end
+
+% Additional files to be compiled.
+sources = {};
+
+% Only compile if files have changed
+compile_script(cpp_file, out_file, sources, extra_arguments);
+
+[importance, baseline_error] = sherwood_importance_mex(features, labels, settings.generate_struct);
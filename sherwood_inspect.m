@@ -0,0 +1,38 @@
+% Structure of the forest settings.ForestName, without classifying.
+%
+% summary.NodeCount(t), summary.LeafCount(t) and summary.Depth(t) are the
+% number of nodes in use, leaves and depth of the deepest leaf of tree t,
+% summary.Bytes(t) its size in memory.
+% summary.DepthHistogram(d+1,t) is the number of leaves at depth d of
+% tree t (the root has depth 0).
+% summary.LeafTree, summary.LeafNode and summary.LeafSamples have one
+% element per leaf: the zero based tree and node index (as the leaves
+% output of sherwood_classify) and the number of training examples.
+% summary.FeatureUsage(d) is the number of split nodes using feature d;
+% a hyperplane split adds its absolute weights normalized to sum to one.
+function summary = sherwood_inspect(settings)
+
+if (~isa(settings, 'SherwoodSettings'))
+	error('First argument must be SherwoodSettings class');
+end
+
+my_path = fileparts(mfilename('fullpath'));
+addpath([my_path filesep 'include']);
+
+cpp_file = 'sherwood_inspect_mex.cpp';
+[~,out_file] = fileparts(cpp_file);
+out_file = ['include' filesep out_file];
+
+% Includes etc
+extra_arguments = {};
+extra_arguments{end+1} = ['-I' my_path];
+extra_arguments{end+1} = ['-I' my_path filesep 'include'];
+extra_arguments{end+1} = ['-I' my_path filesep 'Sherwood' filesep 'cpp' filesep 'lib'];
+
+% Additional files to be compiled.
+sources = {};
+
+% Only compile if files have changed
+compile_script(cpp_file, out_file, sources, extra_arguments);
+
+summary = sherwood_inspect_mex(settings.generate_struct);
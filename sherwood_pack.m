@@ -0,0 +1,40 @@
+% Writes the forest settings.ForestName to packed_name in a packed layout
+% that sherwood_classify maps into memory instead of loading. Workers
+% classifying with the same packed forest (settings.MaxThreads > 1) then
+% share one copy of it, and attaching to it takes no time.
+%
+% On Linux a packed forest in /dev/shm stays in shared memory:
+%
+% sherwood_pack(settings, '/dev/shm/forest');
+% settings.ForestName = '/dev/shm/forest';
+% P = sherwood_classify(features, settings);
+function sherwood_pack(settings, packed_name)
+
+if (~isa(settings, 'SherwoodSettings'))
+	error('First argument must be SherwoodSettings class');
+end
+
+if (~ischar(packed_name))
+	error('Second argument must be the name of the packed forest');
+end
+
+my_path = fileparts(mfilename('fullpath'));
+addpath([my_path filesep 'include']);
+
+cpp_file = 'sherwood_pack_mex.cpp';
+[~,out_file] = fileparts(cpp_file);
+out_file = ['include' filesep out_file];
+
+% Includes etc
+extra_arguments = {};
+extra_arguments{end+1} = ['-I' my_path];
+extra_arguments{end+1} = ['-I' my_path filesep 'include'];
+extra_arguments{end+1} = ['-I' my_path filesep 'Sherwood' filesep 'cpp' filesep 'lib'];
+
+% Additional files to be compiled.
+sources = {};
+
+% Only compile if files have changed
+compile_script(cpp_file, out_file, sources, extra_arguments);
+
+sherwood_pack_mex(settings.generate_struct, packed_name);
@@ -0,0 +1,133 @@
+% Trains a forest for each combination of the settings in grid and
+% returns its error, without saving the forests.
+%
+% grid is a struct with SherwoodSettings properties as fields and the
+% values to try as arrays (or cell arrays of strings), e.g.
+%   grid.MaxDecisionLevels = [5 10 15];
+%   grid.NumberOfTrees = [10 50 100];
+% Other properties are taken from settings; WeakLearner, FeatureScaling
+% and Task cannot be varied.
+%
+% The error is the misclassification rate (mean squared error for
+% regression) on validation_features and validation_labels, or the
+% out-of-bag error if they are not given (all forests are then trained
+% with Bootstrap).
+%
+% results(k) has the grid fields of combination k, its Error and the
+% Seconds spent training its trees. The data is preprocessed once,
+% combinations differing only in NumberOfTrees share their trees and
+% settings.MaxThreads combinations are trained in parallel.
+function results = sherwood_sweep(features, labels, settings, grid, validation_features, validation_labels)
+
+if (~isa(settings, 'SherwoodSettings'))
+	error('Third argument must be SherwoodSettings class');
+end
+
+% Set to false if the compiler does not support OpenMP, see sherwood_train.m.
+use_openmp = true;
+
+my_path = fileparts(mfilename('fullpath'));
+addpath([my_path filesep 'include']);
+
+if (size(features,2) ~= numel(labels))
+	error('Number of columns in feature vector (number of examples) must be same as length of labels')
+end
+
+features = single(features);
+labels = convert_labels(labels, settings);
+
+validation = nargin > 4;
+if (validation)
+	validation_features = single(validation_features);
+	validation_labels = convert_labels(validation_labels, settings);
+end
+
+% All combinations of the grid values.
+names = fieldnames(grid);
+values = cell(1, numel(names));
+for f = 1:numel(names)
+	values{f} = grid.(names{f});
+	if ~iscell(values{f})
+		values{f} = num2cell(values{f});
+	end
+end
+
+counts = cellfun(@numel, values);
+ranges = cellfun(@(n) 1:n, num2cell(counts), 'UniformOutput', false);
+indices = cell(1, numel(names));
+[indices{:}] = ndgrid(ranges{:});
+
+combinations = prod(counts);
+configurations = cell(1, combinations);
+results = repmat(struct(), combinations, 1);
+
+for k = 1:combinations
+	s = settings;
+	for f = 1:numel(names)
+		value = values{f}{indices{f}(k)};
+		s.(names{f}) = value;
+		results(k).(names{f}) = value;
+	end
+	configurations{k} = s.generate_struct;
+end
+
+cpp_file = 'sherwood_sweep_mex.cpp';
+[~,out_file] = fileparts(cpp_file);
+out_file = ['include' filesep out_file];
+
+% Includes etc
+extra_arguments = {};
+extra_arguments{end+1} = ['-I' my_path];
+extra_arguments{end+1} = ['-I' my_path filesep 'include'];
+extra_arguments{end+1} = ['-I' my_path filesep 'Sherwood' filesep 'cpp' filesep 'lib'];
+
+if (use_openmp)
+	if ~ispc
+		extra_arguments{end+1} = '-lgomp';
+		extra_arguments{end+1} = 'CXXFLAGS="\$CXXFLAGS -fopenmp"';
+	else
+		extra_arguments{end+1} = 'COMPFLAGS="$COMPFLAGS /openmp"';
+	end
+
+	extra_arguments{end+1} = '-DUSE_OPENMP=1';
+else
+	extra_arguments{end+1} = '-DUSE_OPENMP=0'; %#ok<UNRCH>
+end
+
+% Additional files to be compiled.
+sources = {};
+
+% Only compile if files have changed
+compile_script(cpp_file, out_file, sources, extra_arguments);
+
+if (validation)
+	[errors, seconds] = sherwood_sweep_mex(features, labels, settings.generate_struct, configurations, ...
+		validation_features, validation_labels);
+else
+	[errors, seconds] = sherwood_sweep_mex(features, labels, settings.generate_struct, configurations);
+end
+
+for k = 1:combinations
+	results(k).Error = errors(k);
+	results(k).Seconds = seconds(k);
+end
+
+end
+
+% Labels as uint8, uint16 or uint32 from 0 (single targets for regression).
+function labels = convert_labels(labels, settings)
+	if strcmp(settings.Task, 'regression')
+		labels = single(labels);
+		return;
+	end
+
+	if (min(labels(:)) < 1)
+		error('Labels ids must start at 1');
+	end
+
+	if ~(isa(labels,'uint8') || isa(labels,'uint16') || isa(labels,'uint32'))
+		labels = uint32(labels);
+	end
+
+	labels = labels-1;
+end
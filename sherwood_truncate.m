@@ -0,0 +1,47 @@
+% Writes the forest settings.ForestName truncated to each of levels
+% (as settings.MaxDecisionLevels) to the files forest_names{k}; split
+% nodes at the last level become leaves with the statistics of their
+% training examples.
+%
+% Trained with settings.Seed set, the truncated forests equal the forests
+% trained with the same settings and MaxDecisionLevels levels(k), so
+% several depths can be compared from one training run:
+%
+% settings.Seed = 1;
+% settings.MaxDecisionLevels = 12;
+% sherwood_train(features, labels, settings);
+% sherwood_truncate(settings, [8 10], {'forest8', 'forest10'});
+function sherwood_truncate(settings, levels, forest_names)
+
+if (~isa(settings, 'SherwoodSettings'))
+	error('First argument must be SherwoodSettings class');
+end
+
+if ischar(forest_names)
+	forest_names = {forest_names};
+end
+
+if (numel(levels) ~= numel(forest_names))
+	error('Expected one forest name per level');
+end
+
+my_path = fileparts(mfilename('fullpath'));
+addpath([my_path filesep 'include']);
+
+cpp_file = 'sherwood_truncate_mex.cpp';
+[~,out_file] = fileparts(cpp_file);
+out_file = ['include' filesep out_file];
+
+% Includes etc
+extra_arguments = {};
+extra_arguments{end+1} = ['-I' my_path];
+extra_arguments{end+1} = ['-I' my_path filesep 'include'];
+extra_arguments{end+1} = ['-I' my_path filesep 'Sherwood' filesep 'cpp' filesep 'lib'];
+
+% Additional files to be compiled.
+sources = {};
+
+% Only compile if files have changed
+compile_script(cpp_file, out_file, sources, extra_arguments);
+
+sherwood_truncate_mex(settings.generate_struct, double(levels), forest_names);
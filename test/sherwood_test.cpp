@@ -0,0 +1,229 @@
+// Tests of the invariants the tools rely on, runnable without MATLAB.
+//
+// Build with -DSHERWOOD_BUILD_TESTS=ON (the default) and run ctest. The
+// program prints the failed checks and exits with 1 if there are any.
+#include "sherwood_core.h"
+#include "train_forest.h"
+#include "classify_forest.h"
+#include "truncate_forest.h"
+#include "packed_forest.h"
+
+#include <cstdio>
+#include <sstream>
+
+using namespace MicrosoftResearch::Cambridge::Sherwood;
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(condition) \
+  do { \
+    if (!(condition)) { \
+      fprintf(stderr, "%s:%d: %s failed\n", __FILE__, __LINE__, #condition); \
+      failures++; \
+    } \
+  } while (0)
+
+// Gaussian clusters, one per class, with features along rows.
+struct SyntheticData
+{
+  std::vector<float> features;
+  std::vector<unsigned int> labels;
+  unsigned int dimensions;
+  unsigned int count;
+
+  SyntheticData(unsigned int count, unsigned int dimensions, unsigned int classes, unsigned int seed = 1)
+  : features((size_t)count * dimensions), labels(count), dimensions(dimensions), count(count)
+  {
+    Random random(seed);
+
+    std::vector<float> centers((size_t)classes * dimensions);
+    for (size_t i = 0; i < centers.size(); i++) {
+      centers[i] = 4 * (float)random.NextDouble();
+    }
+
+    for (unsigned int i = 0; i < count; i++) {
+      labels[i] = random.Next(0, classes);
+
+      for (unsigned int d = 0; d < dimensions; d++) {
+        features[(size_t)i*dimensions + d] = centers[labels[i]*dimensions + d] + randn(random);
+      }
+    }
+  }
+
+  DataPointCollection Collection() const
+  {
+    return DataPointCollection(&features[0], dimensions, count, &labels[0], DataPointCollection::UInt32Labels);
+  }
+};
+
+Options TrainingOptions(int decisionLevels)
+{
+  Options options;
+  options.MaxDecisionLevels = decisionLevels;
+  options.NumberOfCandidateThresholdsPerFeature = 5;
+  options.NumberOfTrees = 4;
+  options.MaxThreads = 2;
+  options.Seed = 5;
+
+  // The statistics RandomHyperplaneFeatureResponseNormalized needs, the
+  // other features ignore them.
+  options.FeatureScaling = true;
+  return options;
+}
+
+template<typename T>
+std::string Serialized(const T& value)
+{
+  std::ostringstream out;
+  value.Serialize(out);
+  return out.str();
+}
+
+template<typename ForestType>
+std::vector<float> Probabilities(ForestType& forest, const DataPointCollection& data)
+{
+  std::vector<float> probabilities((size_t)CountClasses(forest) * data.Count());
+
+  ClassificationOutputs out;
+  out.probabilities = &probabilities[0];
+  ClassifyForest(forest, data, Options(), out);
+
+  return probabilities;
+}
+
+// A histogram of classes classes, with inline, dense or sparse bins, is
+// read back as it was written.
+void TestHistogramSerialization(unsigned int classes)
+{
+  SyntheticData synthetic(500, 1, classes);
+  DataPointCollection data = synthetic.Collection();
+
+  HistogramAggregator histogram(classes);
+  for (unsigned int i = 0; i < data.Count(); i++) {
+    histogram.Aggregate(data, i);
+  }
+
+  std::stringstream stream;
+  Serialize_(stream, histogram);
+  std::string bytes = stream.str();
+
+  HistogramAggregator loaded;
+  Deserialize_(stream, loaded);
+
+  CHECK(stream.good());
+  CHECK(loaded.BinCount() == classes);
+  CHECK(loaded.SampleCount() == histogram.SampleCount());
+  CHECK(loaded.IsInline() == histogram.IsInline() && loaded.IsSparse() == histogram.IsSparse());
+
+  for (unsigned int c = 0; c < classes; c++) {
+    CHECK(loaded.GetCount(c) == histogram.GetCount(c));
+  }
+
+  std::ostringstream again;
+  Serialize_(again, loaded);
+  CHECK(again.str() == bytes);
+}
+
+// A packed forest classifies as the forest it was packed from.
+template<typename F>
+void TestPackedForest()
+{
+  SyntheticData training(2000, 6, 4);
+  std::auto_ptr<Forest<F, HistogramAggregator> > forest =
+    TrainForest<F, HistogramAggregator>(training.Collection(), TrainingOptions(6));
+
+  const std::string filename = "sherwood_test.packed";
+  PackForest(*forest, filename);
+
+  SyntheticData test(1000, 6, 4, 2);
+  DataPointCollection data(&test.features[0], test.dimensions, test.count);
+
+  {
+    PackedForest<F, HistogramAggregator> packed(filename);
+    CHECK(packed.TreeCount() == forest->TreeCount());
+    CHECK(Probabilities(packed, data) == Probabilities(*forest, data));
+  }
+
+  remove(filename.c_str());
+}
+
+// Truncating a forest to a number of decision levels gives the forest
+// trained with that MaxDecisionLevels and the same Seed.
+template<typename F>
+void TestTruncateForest()
+{
+  SyntheticData training(2000, 6, 4);
+  DataPointCollection data = training.Collection();
+
+  const int deepLevels = 8;
+  std::auto_ptr<Forest<F, HistogramAggregator> > deep =
+    TrainForest<F, HistogramAggregator>(data, TrainingOptions(deepLevels));
+
+  for (int levels = 0; levels <= deepLevels; levels += 2)
+  {
+    std::auto_ptr<Forest<F, HistogramAggregator> > shallow =
+      TrainForest<F, HistogramAggregator>(data, TrainingOptions(levels));
+    std::auto_ptr<Forest<F, HistogramAggregator> > truncated = TruncateForest(*deep, levels);
+
+    CHECK(Serialized(*truncated) == Serialized(*shallow));
+  }
+}
+
+// Samples are distinct values below n, and drawn is left all zero.
+void TestSampleWithoutReplacement()
+{
+  Random random(1);
+  std::vector<unsigned int> sample;
+
+  const unsigned int sizes[] = { 1, 2, 7, 100 };
+  for (unsigned int s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++)
+  {
+    unsigned int n = sizes[s];
+    std::vector<char> drawn(n, 0);
+
+    for (unsigned int count = 0; count <= n; count++)
+    {
+      for (int repeat = 0; repeat < 10; repeat++)
+      {
+        SampleWithoutReplacement(random, n, count, sample, drawn);
+
+        CHECK(sample.size() == count);
+        CHECK(std::count(drawn.begin(), drawn.end(), 0) == (std::ptrdiff_t)n);
+
+        std::vector<unsigned int> sorted(sample);
+        std::sort(sorted.begin(), sorted.end());
+        CHECK(std::unique(sorted.begin(), sorted.end()) == sorted.end());
+        CHECK(sorted.empty() || sorted.back() < n);
+      }
+    }
+  }
+}
+
+}
+
+int main()
+{
+  TestHistogramSerialization(3);
+  TestHistogramSerialization(HistogramAggregator::InlineBinCapacity);
+  TestHistogramSerialization(100);
+  TestHistogramSerialization(1000);
+
+  TestPackedForest<AxisAlignedFeatureResponse>();
+  TestPackedForest<RandomHyperplaneFeatureResponse>();
+  TestPackedForest<RandomHyperplaneFeatureResponseNormalized>();
+
+  TestTruncateForest<AxisAlignedFeatureResponse>();
+  TestTruncateForest<RandomHyperplaneFeatureResponseNormalized>();
+
+  TestSampleWithoutReplacement();
+
+  if (failures > 0) {
+    fprintf(stderr, "%d checks failed\n", failures);
+    return 1;
+  }
+
+  printf("All checks passed\n");
+  return 0;
+}